@@ -2,10 +2,24 @@
 
 #ifndef ARDUINO
 #include <cstdint>
+#include <cstddef>
+#include <cstring>
 #else
 #include <Arduino.h>
 #endif
 
+#if !defined(ARDUINO) && (__cplusplus >= 201703L)
+#include <array>
+#endif
+
+#if !defined(ARDUINO) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if !defined(ARDUINO) && defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 
 namespace proto
 {
@@ -17,163 +31,1351 @@ namespace proto
         eFTR    = 0x7D,
     };
 
-    template<uint8_t NMaxMessage = 10>
-    struct Bicoder
+    // A view of contiguous bytes
+    struct Span
     {
-        static_assert( (0U < NMaxMessage) and (NMaxMessage < 127U),
-                       "The max length of the message is out of range" );
+        const uint8_t*  data;
+        size_t          size;
+    };
 
-        static constexpr uint8_t maxEncodedSize = 2U * NMaxMessage + 2U;
+    namespace detail
+    {
+        constexpr bool isOneOf( const uint8_t data, const uint8_t a, const uint8_t b, const uint8_t c )
+        {
+            return (data == a) or (data == b) or (data == c);
+        }
+    }// detail
 
-        using State_t = bool (Bicoder::*)(const uint8_t data);
+    // The special bytes as a compile-time policy : the header, the escape and
+    // the footer, and the mask XORed with a special byte of the payload after
+    // an escape. Both ends of a link must use the same alphabet.
+    template<uint8_t NHeader, uint8_t NEscape, uint8_t NFooter, uint8_t NXor>
+    struct Alphabet
+    {
+        static_assert( (NHeader != NEscape) and (NHeader != NFooter) and (NEscape != NFooter),
+                       "The special bytes must be distinct" );
+        static_assert( not detail::isOneOf( NHeader ^ NXor, NHeader, NEscape, NFooter ) and
+                       not detail::isOneOf( NEscape ^ NXor, NHeader, NEscape, NFooter ) and
+                       not detail::isOneOf( NFooter ^ NXor, NHeader, NEscape, NFooter ),
+                       "An escaped byte must not be special" );
 
-        Bicoder() = default;
+        static constexpr uint8_t header     = NHeader;
+        static constexpr uint8_t escape     = NEscape;
+        static constexpr uint8_t footer     = NFooter;
+        static constexpr uint8_t xorMask    = NXor;
+
+        // The bytes written around and instead of the special ones. They live in
+        // static storage so sinks may keep pointers to them.
+        static constexpr uint8_t framing[2] = { NHeader, NFooter };
+        static constexpr uint8_t escapeSequences[6] =
+        {
+            NEscape, NHeader ^ NXor,
+            NEscape, NEscape ^ NXor,
+            NEscape, NFooter ^ NXor,
+        };
+
+        static constexpr bool isSpecial( const uint8_t data )
+        {
+            return detail::isOneOf( data, NHeader, NEscape, NFooter );
+        }
+
+        static const uint8_t* escapeSequence( const uint8_t special );
+    };
+
+    template<uint8_t H, uint8_t E, uint8_t F, uint8_t X> constexpr uint8_t Alphabet<H, E, F, X>::header;
+    template<uint8_t H, uint8_t E, uint8_t F, uint8_t X> constexpr uint8_t Alphabet<H, E, F, X>::escape;
+    template<uint8_t H, uint8_t E, uint8_t F, uint8_t X> constexpr uint8_t Alphabet<H, E, F, X>::footer;
+    template<uint8_t H, uint8_t E, uint8_t F, uint8_t X> constexpr uint8_t Alphabet<H, E, F, X>::xorMask;
+    template<uint8_t H, uint8_t E, uint8_t F, uint8_t X> constexpr uint8_t Alphabet<H, E, F, X>::framing[2];
+    template<uint8_t H, uint8_t E, uint8_t F, uint8_t X> constexpr uint8_t Alphabet<H, E, F, X>::escapeSequences[6];
+
+    // Consecutive special bytes (as the default ones) are indexed with a
+    // subtraction, the others with compares folded at compile time
+    template<uint8_t H, uint8_t E, uint8_t F, uint8_t X>
+    inline const uint8_t* Alphabet<H, E, F, X>::escapeSequence( const uint8_t special )
+    {
+        if( (E == H + 1) and (F == H + 2) )
+            return escapeSequences + 2U * static_cast<uint8_t>( special - H );
+
+        return escapeSequences + ((special == H) ? 0U : (special == E) ? 2U : 4U);
+    }
+
+    using DefaultAlphabet = Alphabet<ESpecial::eHDR, ESpecial::eESC, ESpecial::eFTR, ESpecial::eXOR>;
+
+    namespace detail
+    {
+        template<typename TAlphabet = DefaultAlphabet>
+        constexpr bool isSpecial( const uint8_t data )
+        {
+            return TAlphabet::isSpecial( data );
+        }
+
+#if !defined(ARDUINO) && defined(__AVX2__)
+        // One bit per byte of the 32 bytes at block, set for the special ones
+        template<typename TAlphabet>
+        inline uint32_t specialMask32( const uint8_t* block )
+        {
+            const __m256i hdr   = _mm256_set1_epi8( static_cast<char>( TAlphabet::header ) );
+            const __m256i esc   = _mm256_set1_epi8( static_cast<char>( TAlphabet::escape ) );
+            const __m256i ftr   = _mm256_set1_epi8( static_cast<char>( TAlphabet::footer ) );
+            const __m256i bytes = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( block ) );
+            const __m256i hit   = _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8( bytes, hdr ),
+                                                                    _mm256_cmpeq_epi8( bytes, esc ) ),
+                                                   _mm256_cmpeq_epi8( bytes, ftr ) );
+
+            return static_cast<uint32_t>( _mm256_movemask_epi8( hit ) );
+        }
+#endif
+#if !defined(ARDUINO) && defined(__SSE2__)
+        // One bit per byte of the 16 bytes at block, set for the special ones
+        template<typename TAlphabet>
+        inline uint32_t specialMask16( const uint8_t* block )
+        {
+            const __m128i hdr   = _mm_set1_epi8( static_cast<char>( TAlphabet::header ) );
+            const __m128i esc   = _mm_set1_epi8( static_cast<char>( TAlphabet::escape ) );
+            const __m128i ftr   = _mm_set1_epi8( static_cast<char>( TAlphabet::footer ) );
+            const __m128i bytes = _mm_loadu_si128( reinterpret_cast<const __m128i*>( block ) );
+            const __m128i hit   = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( bytes, hdr ),
+                                                              _mm_cmpeq_epi8( bytes, esc ) ),
+                                                _mm_cmpeq_epi8( bytes, ftr ) );
+
+            return static_cast<uint32_t>( _mm_movemask_epi8( hit ) );
+        }
+#endif
+
+        // Returns the first byte in [first, last) that is special in TAlphabet
+        // or last if there is no such byte
+        template<typename TAlphabet = DefaultAlphabet>
+        const uint8_t* findSpecial( const uint8_t* first, const uint8_t* last )
+        {
+#if !defined(ARDUINO) && defined(__AVX2__)
+            for( ; (last - first) >= 32; first += 32 )
+            {
+                const uint32_t mask = specialMask32<TAlphabet>( first );
+                if( mask )
+                    return first + __builtin_ctz( mask );
+            }
+#endif
+#if !defined(ARDUINO) && defined(__SSE2__)
+            for( ; (last - first) >= 16; first += 16 )
+            {
+                const uint32_t mask = specialMask16<TAlphabet>( first );
+                if( mask )
+                    return first + __builtin_ctz( mask );
+            }
+#endif
+            for( ; first != last; ++first )
+            {
+                if( TAlphabet::isSpecial( *first ) )
+                    return first;
+            }
+
+            return last;
+        }
+
+        // Returns the first header in [first, last) or last if there is none
+        template<typename TAlphabet = DefaultAlphabet>
+        const uint8_t* findHeader( const uint8_t* first, const uint8_t* last )
+        {
+            // memchr() wants a valid pointer even for nothing, an empty input may have none
+            if( first == last )
+                return last;
+
+            const void* header = memchr( first, TAlphabet::header, static_cast<size_t>( last - first ) );
+
+            return header ? static_cast<const uint8_t*>( header ) : last;
+        }
+
+        // Returns the number of special bytes in [first, last)
+        template<typename TAlphabet = DefaultAlphabet>
+        size_t countSpecial( const uint8_t* first, const uint8_t* last )
+        {
+            size_t count = 0;
+#if !defined(ARDUINO) && defined(__AVX2__)
+            for( ; (last - first) >= 32; first += 32 )
+                count += static_cast<size_t>( __builtin_popcount( specialMask32<TAlphabet>( first ) ) );
+#endif
+#if !defined(ARDUINO) && defined(__SSE2__)
+            for( ; (last - first) >= 16; first += 16 )
+                count += static_cast<size_t>( __builtin_popcount( specialMask16<TAlphabet>( first ) ) );
+#endif
+            for( ; first != last; ++first )
+                count += TAlphabet::isSpecial( *first ) ? 1U : 0U;
+
+            return count;
+        }
+
+        // Writes the bytes in [run, special) then the escape sequence of special
+        // and moves run past it
+        template<typename TAlphabet, typename TSink>
+        inline bool writeEscaped( const uint8_t*& run, const uint8_t* special, TSink& sink )
+        {
+            if( (special != run) and not sink.write( run, static_cast<size_t>( special - run ) ) )
+                return false;
+
+            run = special + 1;
+            return sink.write( TAlphabet::escapeSequence( *special ), 2U );
+        }
+
+        // Writes the escaped payload through sink.write( data, size ) which
+        // returns false when the output is full. Runs without special bytes are
+        // passed as a whole and point into the payload itself.
+        //
+        // Each block is classified once : the special bytes of a block are
+        // escaped from its mask, a block without any joins the current run.
+        template<typename TAlphabet, typename TSink>
+        bool encodePayload( const uint8_t* data, size_t size, TSink& sink )
+        {
+            const uint8_t* const last = data + size;
+            const uint8_t* run = data;
+
+#if !defined(ARDUINO) && defined(__AVX2__)
+            for( ; (last - data) >= 32; data += 32 )
+            {
+                for( uint32_t mask = specialMask32<TAlphabet>( data ); mask != 0; mask &= mask - 1 )
+                {
+                    if( not writeEscaped<TAlphabet>( run, data + __builtin_ctz( mask ), sink ) )
+                        return false;
+                }
+            }
+#endif
+#if !defined(ARDUINO) && defined(__SSE2__)
+            for( ; (last - data) >= 16; data += 16 )
+            {
+                for( uint32_t mask = specialMask16<TAlphabet>( data ); mask != 0; mask &= mask - 1 )
+                {
+                    if( not writeEscaped<TAlphabet>( run, data + __builtin_ctz( mask ), sink ) )
+                        return false;
+                }
+            }
+#endif
+            for( ; data != last; ++data )
+            {
+                if( TAlphabet::isSpecial( *data ) and not writeEscaped<TAlphabet>( run, data, sink ) )
+                    return false;
+            }
+
+            return (run == last) or sink.write( run, static_cast<size_t>( last - run ) );
+        }
+
+        // Copies into a fixed-size buffer
+        struct BufferSink
+        {
+            uint8_t*    out;
+            size_t      capacity;
+            size_t      size;
+
+            bool write( const uint8_t* data, const size_t n )
+            {
+                if( (capacity - size) < n )
+                    return false;
+
+                memcpy( out + size, data, n );
+                size += n;
+                return true;
+            }
+        };
+
+        // Escapes [first, last) byte by byte into out, returns the end of the output.
+        // Two bytes are always written, out needs room for 2 * (last - first) bytes.
+        template<typename TAlphabet>
+        inline uint8_t* escapeBytes( const uint8_t* first, const uint8_t* last, uint8_t* out )
+        {
+            // No branch : random special bytes would defeat the prediction
+            for( ; first != last; ++first )
+            {
+                const uint8_t data = *first;
+                const uint8_t special = TAlphabet::isSpecial( data ) ? 1U : 0U;
+
+                out[0] = static_cast<uint8_t>( data ^ ((data ^ TAlphabet::escape) & -special) );
+                out[1] = data ^ TAlphabet::xorMask;
+                out += 1U + special;
+            }
+
+            return out;
+        }
+
+        // When the buffer has room for every byte escaped, the payload is written
+        // straight into it : a block without special bytes is copied at once, the
+        // others are escaped byte by byte.
+        template<typename TAlphabet>
+        bool encodePayload( const uint8_t* data, size_t size, BufferSink& sink )
+        {
+            if( (sink.capacity - sink.size) / 2U < size )
+                return encodePayload<TAlphabet, BufferSink>( data, size, sink );
+
+            const uint8_t* const last = data + size;
+            uint8_t* out = sink.out + sink.size;
+
+#if !defined(ARDUINO) && defined(__AVX2__)
+            for( ; (last - data) >= 32; data += 32 )
+            {
+                if( specialMask32<TAlphabet>( data ) != 0 )
+                    out = escapeBytes<TAlphabet>( data, data + 32, out );
+                else
+                {
+                    memcpy( out, data, 32 );
+                    out += 32;
+                }
+            }
+#endif
+#if !defined(ARDUINO) && defined(__SSE2__)
+            for( ; (last - data) >= 16; data += 16 )
+            {
+                if( specialMask16<TAlphabet>( data ) != 0 )
+                    out = escapeBytes<TAlphabet>( data, data + 16, out );
+                else
+                {
+                    memcpy( out, data, 16 );
+                    out += 16;
+                }
+            }
+#endif
+            out = escapeBytes<TAlphabet>( data, last, out );
+            sink.size = static_cast<size_t>( out - sink.out );
+
+            return true;
+        }
+
+        template<typename TAlphabet, typename TSink>
+        bool encodeFrame( const uint8_t* data, size_t size, TSink& sink )
+        {
+            return sink.write( TAlphabet::framing, 1U ) and
+                   encodePayload<TAlphabet>( data, size, sink ) and
+                   sink.write( TAlphabet::framing + 1, 1U );
+        }
+
+        template<typename TAlphabet, typename TSink>
+        bool encodeFrame( const Span* segments, size_t count, TSink& sink )
+        {
+            if( not sink.write( TAlphabet::framing, 1U ) )
+                return false;
+
+            for( size_t i = 0; i < count; ++i )
+            {
+                if( not encodePayload<TAlphabet>( segments[i].data, segments[i].size, sink ) )
+                    return false;
+            }
+
+            return sink.write( TAlphabet::framing + 1, 1U );
+        }
+
+        inline size_t totalSize( const Span* segments, size_t count )
+        {
+            size_t size = 0;
+            for( size_t i = 0; i < count; ++i )
+                size += segments[i].size;
+            return size;
+        }
 
+        // Copies through an output iterator, never full
+        template<typename TOutputIt>
+        struct IteratorSink
+        {
+            TOutputIt   out;
+
+            bool write( const uint8_t* data, const size_t n )
+            {
+                for( size_t i = 0; i < n; ++i )
+                    *out++ = data[i];
+                return true;
+            }
+        };
+    }// detail
+
+    // What happened after feeding bytes to a decoder
+    enum EDecodeResult : uint8_t
+    {
+        eNeedMore,      // No message is completed yet
+        eFrameReady,    // A message is completed
+        eError,         // A header aborted the message, a new one is started
+        eOverflow,      // The message is longer than the buffer
+    };
+
+    // The size of the encoded message if every payload byte needs escaping
+    constexpr size_t maxEncodedSize( const size_t size )
+    {
+        return 2U * size + 2U;
+    }
+
+    // The exact size of the encoded message
+    template<typename TAlphabet = DefaultAlphabet>
+    size_t encodedSize( const uint8_t* data, size_t size )
+    {
+        return size + detail::countSpecial<TAlphabet>( data, data + size ) + 2U;
+    }
+
+    template<typename TAlphabet = DefaultAlphabet>
+    size_t encodedSize( const Span* segments, size_t count )
+    {
+        size_t size = 2U;
+        for( size_t i = 0; i < count; ++i )
+            size += encodedSize<TAlphabet>( segments[i].data, segments[i].size ) - 2U;
+        return size;
+    }
+
+#if !defined(ARDUINO) && (__cplusplus >= 201703L)
+    namespace detail
+    {
+        template<typename TAlphabet>
+        constexpr size_t countSpecialConstant( const uint8_t* data, size_t size )
+        {
+            size_t count = 0;
+            for( size_t i = 0; i < size; ++i )
+                count += TAlphabet::isSpecial( data[i] ) ? 1U : 0U;
+            return count;
+        }
+
+        // The encoder usable in constant expressions, NSize is the exact encoded size
+        template<typename TAlphabet, size_t NSize>
+        constexpr std::array<uint8_t, NSize> encodeConstant( const uint8_t* data, size_t size )
+        {
+            std::array<uint8_t, NSize> frame {};
+            size_t index = 0;
+
+            frame[index++] = TAlphabet::header;
+            for( size_t i = 0; i < size; ++i )
+            {
+                if( TAlphabet::isSpecial( data[i] ) )
+                {
+                    frame[index++] = TAlphabet::escape;
+                    frame[index++] = data[i] ^ TAlphabet::xorMask;
+                }
+                else
+                    frame[index++] = data[i];
+            }
+            frame[index++] = TAlphabet::footer;
+
+            return frame;
+        }
+    }// detail
+
+    // The encoded message of a constant payload given byte by byte, e.g.
+    //     static constexpr auto ping = proto::makeFrame<0x01, 0x7B>();
+    // so constant messages cost nothing to encode and live in read-only data.
+    // Another alphabet is given first : makeFrame<MyAlphabet, 0x01, 0x7B>().
+    template<typename TAlphabet, uint8_t... Bytes>
+    constexpr std::array<uint8_t, sizeof...(Bytes) + (size_t( TAlphabet::isSpecial( Bytes ) ) + ... + 0U) + 2U> makeFrame()
+    {
+        constexpr uint8_t payload[] = { Bytes..., 0 };
+        constexpr size_t size = sizeof...(Bytes) + (size_t( TAlphabet::isSpecial( Bytes ) ) + ... + 0U) + 2U;
+
+        return detail::encodeConstant<TAlphabet, size>( payload, sizeof...(Bytes) );
+    }
+
+    template<uint8_t... Bytes>
+    constexpr auto makeFrame()
+    {
+        return makeFrame<DefaultAlphabet, Bytes...>();
+    }
+
+    // The same for a constant array (built-in or std::array) with static storage
+    template<typename TAlphabet, const auto& Payload>
+    constexpr auto makeFrame()
+    {
+        constexpr size_t size = sizeof(Payload) / sizeof(Payload[0]);
+        constexpr size_t encoded = size + detail::countSpecialConstant<TAlphabet>( &Payload[0], size ) + 2U;
+
+        return detail::encodeConstant<TAlphabet, encoded>( &Payload[0], size );
+    }
+
+    template<const auto& Payload>
+    constexpr auto makeFrame()
+    {
+        return makeFrame<DefaultAlphabet, Payload>();
+    }
+#endif
+
+    // Records the pieces of an encoded message instead of copying them, e.g.
+    // into struct iovec for writev(). TIoVec needs iov_base and iov_len members.
+    // The pieces point into the payload, which must outlive them. A piece that
+    // starts where the previous one ends is merged into it, so the number of
+    // pieces depends on where the payload and the escape sequences lie in memory.
+    template<typename TIoVec>
+    struct GatherSink
+    {
+        TIoVec*     out;
+        size_t      capacity;
+        size_t      size;
+
+        bool write( const uint8_t* data, const size_t n )
+        {
+            if( size != 0 )
+            {
+                TIoVec& last = out[size - 1];
+                if( static_cast<const uint8_t*>( last.iov_base ) + last.iov_len == data )
+                {
+                    last.iov_len += n;
+                    return true;
+                }
+            }
+
+            if( size == capacity )
+                return false;
+
+            out[size].iov_base  = const_cast<uint8_t*>( data );
+            out[size].iov_len   = n;
+            ++size;
+            return true;
+        }
+    };
+
+    // The receive half of the Bicoder. The state is kept in a single byte and
+    // dispatched with a switch the compiler can inline. The buffer and its
+    // capacity are given at runtime, so a single copy of the code serves every
+    // message length.
+    //
+    // TSize is the type of all the sizes and indices (uint8_t, uint16_t or
+    // uint32_t), TAlphabet the special bytes.
+    template<typename TSize = uint8_t, typename TAlphabet = DefaultAlphabet>
+    struct BasicDecoder
+    {
+        // A capacity beyond what TSize can count is clamped to its maximum
+        BasicDecoder( uint8_t* buffer, size_t capacity ) : m_buffer( buffer ), m_capacity( clampCapacity( capacity ) ) {}
+
+        EDecodeResult   decode( const uint8_t data );
+        EDecodeResult   decode( const uint8_t* data, size_t size, size_t& consumed );
         bool            decodeByte( const uint8_t data );
-        bool            decodeMessage( const uint8_t* data, uint8_t size );
-        bool            encodeMessage( const uint8_t* data, uint8_t size );
+        bool            decodeMessage( const uint8_t* data, TSize size );
+        size_t          decodeChunk( const uint8_t* data, size_t size );
         void            reset();
-        bool            isCompleted() const { return m_isCompleted; }
-        uint8_t         size() const { return m_index; }
-        const uint8_t*  buff() const { return m_message; }
+        bool            isCompleted() const { return m_state == eCompleted; }
+        TSize           size() const { return m_index; }
+        TSize           capacity() const { return m_capacity; }
+        const uint8_t*  buff() const { return m_buffer; }
 
-        private :
-            bool        waitHeader(const uint8_t data);
-            bool        inMessage(const uint8_t data);
-            bool        afterEscape(const uint8_t data);
+        // The number of messages aborted by a header (reported as eError)
+        uint32_t        resyncs() const { return m_resyncs; }
 
-            void        appendMessage( const uint8_t data );
-            bool        pushByte( const uint8_t data );
-            bool        encodeByte( const uint8_t data );
+        // Collect the next messages into another buffer. A message being
+        // received is discarded.
+        void            setBuffer( uint8_t* buffer, size_t capacity );
 
-            State_t     m_state { &Bicoder::waitHeader };
-            uint8_t     m_message[maxEncodedSize] = { 0 };
-            uint8_t     m_index { 0 };
-            bool        m_isCompleted { false };
+        protected :
+            enum EState : uint8_t
+            {
+                eWaitHeader,
+                eInMessage,
+                eAfterEscape,
+                eCompleted,
+            };
+
+            EDecodeResult pushByte( const uint8_t data );
+            EDecodeResult resync();
+
+            static TSize clampCapacity( size_t capacity )
+            {
+                return static_cast<TSize>( (capacity < static_cast<TSize>( -1 )) ? capacity : static_cast<TSize>( -1 ) );
+            }
+
+            uint8_t*    m_buffer;
+            uint32_t    m_resyncs { 0 };
+            TSize       m_capacity;
+            TSize       m_index { 0 };
+            uint8_t     m_state { eWaitHeader };
     };
 
-    template<uint8_t N>
-    void Bicoder<N>::appendMessage( const uint8_t data )
+    template<typename TSize, typename TAlphabet>
+    void BasicDecoder<TSize, TAlphabet>::setBuffer( uint8_t* buffer, size_t capacity )
     {
-        m_message[m_index] = data;
-        m_index++;
+        reset();
+        m_buffer    = buffer;
+        m_capacity  = clampCapacity( capacity );
     }
 
-    template<uint8_t N>
-    bool Bicoder<N>::pushByte( const uint8_t data )
+    template<typename TSize, typename TAlphabet>
+    EDecodeResult BasicDecoder<TSize, TAlphabet>::pushByte( const uint8_t data )
     {
-        if( m_index >= N )
+        if( m_index >= m_capacity )
         {
             reset();
-            return false;
+            return eOverflow;
         }
 
-        appendMessage( data );
+        m_buffer[m_index++] = data;
 
-        return true;
+        return eNeedMore;
     }
 
-    template<uint8_t N>
-    void Bicoder<N>::reset()
+    // A header always starts a new message : the current one is aborted
+    template<typename TSize, typename TAlphabet>
+    EDecodeResult BasicDecoder<TSize, TAlphabet>::resync()
     {
-        m_index             = 0;
-        m_state             = &Bicoder::waitHeader;
-        m_isCompleted       = false;
+        m_index = 0;
+        m_state = eInMessage;
+        ++m_resyncs;
+
+        return eError;
     }
 
-    template<uint8_t N>
-    bool Bicoder<N>::decodeByte( const uint8_t data )
+    template<typename TSize, typename TAlphabet>
+    void BasicDecoder<TSize, TAlphabet>::reset()
     {
-        return (this->*m_state)( data );
+        m_index = 0;
+        m_state = eWaitHeader;
     }
 
-    template<uint8_t N>
-    bool Bicoder<N>::decodeMessage( const uint8_t* data, uint8_t size )
+    template<typename TSize, typename TAlphabet>
+    inline EDecodeResult BasicDecoder<TSize, TAlphabet>::decode( const uint8_t data )
+    {
+        switch( m_state )
+        {
+            case eInMessage :
+                switch( data )
+                {
+                    case TAlphabet::footer :
+                        m_state = eCompleted;
+                        return eFrameReady;
+                    case TAlphabet::escape :
+                        m_state = eAfterEscape;
+                        return eNeedMore;
+                    case TAlphabet::header :
+                        return resync();
+                    default :
+                        return pushByte( data );
+                }
+            case eAfterEscape :
+                if( data == TAlphabet::header )
+                    return resync();
+                m_state = eInMessage;
+                return pushByte( data ^ TAlphabet::xorMask );
+            default : // eWaitHeader and eCompleted
+                m_index = 0;
+                m_state = (data == TAlphabet::header) ? eInMessage : eWaitHeader;
+                return eNeedMore;
+        }
+    }
+
+    template<typename TSize, typename TAlphabet>
+    inline bool BasicDecoder<TSize, TAlphabet>::decodeByte( const uint8_t data )
+    {
+        return decode( data ) <= eFrameReady;
+    }
+
+    template<typename TSize, typename TAlphabet>
+    bool BasicDecoder<TSize, TAlphabet>::decodeMessage( const uint8_t* data, TSize size )
     {
         reset();
 
-        for( uint8_t i = 0; (i < size); ++i )
+        for( TSize i = 0; (i < size); ++i )
         {
             if( not decodeByte( data[i] ) )
                 return false;
         }
 
-        return m_isCompleted;
+        return isCompleted();
     }
 
-    template<uint8_t N>
-    bool Bicoder<N>::encodeByte( const uint8_t data )
+    // Decodes bytes until something other than eNeedMore happens or the chunk
+    // is exhausted. Yields exactly the same results as feeding the same bytes
+    // to decode() one by one.
+    //
+    // Runs without special bytes are copied at once. After a short run the
+    // next bytes go through decode() one by one : with many escapes a scan per
+    // escape would be slower than that.
+    template<typename TSize, typename TAlphabet>
+    EDecodeResult BasicDecoder<TSize, TAlphabet>::decode( const uint8_t* data, size_t size, size_t& consumed )
     {
-        switch( data )
+        constexpr size_t shortRun = 16;
+        constexpr ptrdiff_t bytewiseRun = 64;
+
+        const uint8_t* const last = data + size;
+        const uint8_t* it = data;
+        EDecodeResult result = eNeedMore;
+
+        while( it != last )
         {
-            case( ESpecial::eHDR ) :
-            case( ESpecial::eESC ) :
-            case( ESpecial::eFTR ) :
-                appendMessage( ESpecial::eESC );
-                appendMessage( data ^ ESpecial::eXOR );
+            if( (m_state == eWaitHeader) or (m_state == eCompleted) )
+            {
+                // Only a header matters, skip everything up to it at once
+                m_index = 0;
+                m_state = eWaitHeader;
+                if( *it != TAlphabet::header )
+                    it = detail::findHeader<TAlphabet>( it, last );
+
+                if( it == last )
+                    break;
+
+                m_state = eInMessage;
+                ++it;
+                continue;
+            }
+
+            if( m_state == eInMessage )
+            {
+                const uint8_t* special = detail::findSpecial<TAlphabet>( it, last );
+                const size_t run = static_cast<size_t>( special - it );
+                const size_t room = m_capacity - m_index;
+
+                if( run > room )
+                {
+                    // The byte right after the room overflows the message
+                    memcpy( m_buffer + m_index, it, room );
+                    it += room + 1;
+                    reset();
+                    result = eOverflow;
+                    break;
+                }
+
+                memcpy( m_buffer + m_index, it, run );
+                m_index += static_cast<TSize>( run );
+                it = special;
+
+                if( it == last )
+                    break;
+
+                if( run < shortRun )
+                {
+                    const uint8_t* const stop = ((last - it) > bytewiseRun) ? it + bytewiseRun : last;
+                    while( (it != stop) and (result == eNeedMore) )
+                        result = decode( *it++ );
+
+                    if( result != eNeedMore )
+                        break;
+                    continue;
+                }
+            }
+
+            result = decode( *it++ );
+
+            if( result != eNeedMore )
                 break;
-            default :
-                appendMessage( data );
         }
 
-        return true;
+        // The rest of a too long message can't be anything but garbage
+        if( result == eOverflow )
+            it = detail::findHeader<TAlphabet>( it, last );
+
+        consumed = static_cast<size_t>( it - data );
+
+        return result;
     }
 
-    template<uint8_t N>
-    bool Bicoder<N>::encodeMessage( const uint8_t* data, uint8_t size )
+    // Decodes bytes until a message is completed or the chunk is exhausted
+    // skipping the errors. Returns the number of bytes consumed.
+    template<typename TSize, typename TAlphabet>
+    size_t BasicDecoder<TSize, TAlphabet>::decodeChunk( const uint8_t* data, size_t size )
     {
-        reset();
+        size_t total = 0;
+
+        while( total != size )
+        {
+            size_t consumed = 0;
+            const EDecodeResult result = decode( data + total, size - total, consumed );
+            total += consumed;
+
+            if( result == eFrameReady )
+                break;
+        }
+
+        return total;
+    }
+
+    // A BasicDecoder with a buffer for exactly NMaxMessage decoded bytes inside.
+    // TSize must be able to hold the encoded size of the longest message.
+    template<uint32_t NMaxMessage = 10, typename TSize = uint8_t, typename TAlphabet = DefaultAlphabet>
+    struct Decoder : BasicDecoder<TSize, TAlphabet>
+    {
+        static_assert( (0U < NMaxMessage) and (2ULL * NMaxMessage + 2U <= static_cast<TSize>( -1 )),
+                       "The max length of the message is out of range" );
+
+        Decoder() : BasicDecoder<TSize, TAlphabet>( m_message, NMaxMessage ) {}
+        Decoder( const Decoder& other ) : BasicDecoder<TSize, TAlphabet>( other ) { copyMessage( other ); }
+        Decoder& operator=( const Decoder& other );
+
+        // Collect the next messages straight into the caller's buffer (at most
+        // min(capacity, NMaxMessage) bytes) instead of the internal one. A message
+        // being received is discarded. nullptr switches back to the internal buffer.
+        void            setFrameBuffer( uint8_t* buffer, size_t capacity );
+
+        // Hands the caller's buffer holding the completed message back to the
+        // caller and switches to the internal buffer. Returns nullptr if there
+        // is no completed message or it is in the internal buffer.
+        uint8_t*        releaseFrame( TSize& size );
+
+        private :
+            void        copyMessage( const Decoder& other );
+
+            uint8_t     m_message[NMaxMessage] = { 0 };
+    };
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    Decoder<N, TSize, TAlphabet>& Decoder<N, TSize, TAlphabet>::operator=( const Decoder& other )
+    {
+        if( this == &other )
+            return *this;
+
+        BasicDecoder<TSize, TAlphabet>::operator=( other );
+        copyMessage( other );
+
+        return *this;
+    }
+
+    // A copy always collects into its own internal buffer, so a caller's buffer
+    // is never written by two decoders nor released twice. The bytes received
+    // so far always fit since a caller's buffer holds at most N bytes.
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    void Decoder<N, TSize, TAlphabet>::copyMessage( const Decoder& other )
+    {
+        memcpy( m_message, other.m_buffer, other.m_index );
+        this->m_buffer      = m_message;
+        this->m_capacity    = static_cast<TSize>( N );
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    void Decoder<N, TSize, TAlphabet>::setFrameBuffer( uint8_t* buffer, size_t capacity )
+    {
+        if( buffer == nullptr )
+            this->setBuffer( m_message, N );
+        else
+            this->setBuffer( buffer, (capacity < N) ? capacity : N );
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    uint8_t* Decoder<N, TSize, TAlphabet>::releaseFrame( TSize& size )
+    {
+        size = 0;
+
+        if( (this->m_buffer == m_message) or not this->isCompleted() )
+            return nullptr;
+
+        uint8_t* frame = this->m_buffer;
+        size = this->m_index;
+        setFrameBuffer( nullptr, 0 );
+
+        return frame;
+    }
+
+    // Decodes whole chunks and calls the callback with a Span of every completed
+    // message while the chunk is being decoded. The callback is a template
+    // parameter so the call can be inlined. The Span is valid during the call only.
+    template<typename TCallback, uint32_t NMaxMessage = 10, typename TSize = uint8_t,
+             typename TAlphabet = DefaultAlphabet>
+    struct FrameDispatcher
+    {
+        explicit FrameDispatcher( const TCallback& callback ) : m_callback( callback ) {}
+
+        // Returns the number of messages delivered
+        size_t                                  feed( const uint8_t* data, size_t size );
+        void                                    reset() { m_decoder.reset(); }
+        Decoder<NMaxMessage, TSize, TAlphabet>& decoder() { return m_decoder; }
+
+        private :
+            TCallback                               m_callback;
+            Decoder<NMaxMessage, TSize, TAlphabet>  m_decoder;
+    };
+
+    template<typename TCallback, uint32_t N, typename TSize, typename TAlphabet>
+    size_t FrameDispatcher<TCallback, N, TSize, TAlphabet>::feed( const uint8_t* data, size_t size )
+    {
+        size_t frames = 0;
+
+        while( size != 0 )
+        {
+            size_t consumed = 0;
+            const EDecodeResult result = m_decoder.decode( data, size, consumed );
+            data += consumed;
+            size -= consumed;
+
+            if( result == eFrameReady )
+            {
+                m_callback( Span { m_decoder.buff(), m_decoder.size() } );
+                ++frames;
+            }
+        }
+
+        return frames;
+    }
+
+    template<uint32_t NMaxMessage, typename TSize = uint8_t, typename TAlphabet = DefaultAlphabet, typename TCallback>
+    FrameDispatcher<TCallback, NMaxMessage, TSize, TAlphabet> makeFrameDispatcher( const TCallback& callback )
+    {
+        return FrameDispatcher<TCallback, NMaxMessage, TSize, TAlphabet>( callback );
+    }
+
+    // Decodes data from its first header on and calls
+    //     callback( result, header, encodedLength )
+    // for every message, completed (eFrameReady, the payload is in the decoder
+    // during the call) or lost (eError, eOverflow). header is the offset of its
+    // header in data. A lost message takes the bytes up to the header aborting
+    // it, or up to the next header after an overflow. Returns the number of
+    // messages.
+    template<typename TSize, typename TAlphabet, typename TCallback>
+    size_t decodeMessages( BasicDecoder<TSize, TAlphabet>& decoder, const uint8_t* data, size_t size, TCallback&& callback )
+    {
+        size_t header = static_cast<size_t>( detail::findHeader<TAlphabet>( data, data + size ) - data );
+        size_t it = header;
+        size_t count = 0;
+
+        while( it != size )
+        {
+            size_t consumed = 0;
+            const EDecodeResult result = decoder.decode( data + it, size - it, consumed );
+            it += consumed;
+
+            if( result == eNeedMore )
+                break;
+
+            // The aborting header is the byte which produced the error
+            const size_t end = (result == eError) ? it - 1 : it;
+
+            callback( result, header, end - header );
+            ++count;
+
+            header = static_cast<size_t>( detail::findHeader<TAlphabet>( data + end, data + size ) - data );
+        }
+
+        return count;
+    }
+
+    // The messages found by decodeBatch() as a structure of arrays. The i-th
+    // message takes length[i] bytes at offset[i] of the arena and status[i] is
+    // eFrameReady, or eError/eOverflow for a lost message (which takes no bytes).
+    struct FrameTable
+    {
+        uint32_t*       offset;
+        uint32_t*       length;
+        EDecodeResult*  status;
+        size_t          capacity;
+        size_t          count;
+    };
+
+    // Decodes the messages in data back to back into the arena (less than
+    // 4 GiB) and records them in the table, until the data or the table runs out
+    // or fewer than maxSize bytes of the arena are left. The decoder is reset and
+    // left collecting into the arena. Returns where to resume with a new arena
+    // and table : past the last message recorded or at the header of an
+    // incomplete one.
+    template<typename TSize, typename TAlphabet>
+    size_t decodeBatch( BasicDecoder<TSize, TAlphabet>& decoder, size_t maxSize, const uint8_t* data, size_t size,
+                        uint8_t* arena, size_t arenaCapacity, FrameTable& table )
+    {
+        size_t used = 0;
+        size_t offset = 0;
+        size_t resume = 0;
+
+        table.count = 0;
+        decoder.setBuffer( arena, maxSize );
+        maxSize = decoder.capacity();   // Clamped to what TSize can count
+
+        while( (offset != size) and (table.count != table.capacity) and (arenaCapacity - used >= maxSize) )
+        {
+            size_t consumed = 0;
+            const EDecodeResult result = decoder.decode( data + offset, size - offset, consumed );
+            offset += consumed;
+
+            if( result == eNeedMore )
+                break;
+
+            const size_t i = table.count++;
+            table.offset[i] = static_cast<uint32_t>( used );
+            table.length[i] = (result == eFrameReady) ? static_cast<uint32_t>( decoder.size() ) : 0U;
+            table.status[i] = result;
+
+            if( result == eFrameReady )
+            {
+                used += decoder.size();
+                decoder.setBuffer( arena + used, maxSize );
+            }
+
+            // A header aborting a message already starts the next one
+            resume = (result == eError) ? offset - 1 : offset;
+        }
+
+        return resume;
+    }
+
+    // The same with messages of up to NMaxMessage bytes, the decoder gets
+    // back to its internal buffer
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    size_t decodeBatch( Decoder<N, TSize, TAlphabet>& decoder, const uint8_t* data, size_t size,
+                        uint8_t* arena, size_t arenaCapacity, FrameTable& table )
+    {
+        const size_t resume = decodeBatch( static_cast<BasicDecoder<TSize, TAlphabet>&>( decoder ), N,
+                                           data, size, arena, arenaCapacity, table );
+        decoder.setFrameBuffer( nullptr, 0 );
+
+        return resume;
+    }
+
+    // Decodes the messages of a buffer in place : every payload is unescaped
+    // over its own encoded bytes and frames receives a Span into data for each
+    // one, up to maxFrames. The messages lost to an overflow of maxSize or to a
+    // header are skipped, just like a Decoder would do. count receives the number
+    // of messages found. Returns where to resume : at the header of the next
+    // message, whose bytes are left intact, or size if there is none.
+    template<typename TAlphabet = DefaultAlphabet>
+    size_t decodeInPlace( uint8_t* data, size_t size, size_t maxSize,
+                          Span* frames, size_t maxFrames, size_t& count )
+    {
+        uint8_t* const last = data + size;
+        uint8_t* header = data + (detail::findHeader<TAlphabet>( data, last ) - data);
+
+        count = 0;
+
+        while( (header != last) and (count != maxFrames) )
+        {
+            // Find where the message ends and how long it is before touching it
+            uint8_t* it = header + 1;
+            uint8_t* next = nullptr;    // The header of the message aborting this one
+            size_t length = 0;
+
+            while( true )
+            {
+                uint8_t* special = data + (detail::findSpecial<TAlphabet>( it, last ) - data);
+                length += static_cast<size_t>( special - it );
+
+                if( length > maxSize )
+                {
+                    next = data + (detail::findHeader<TAlphabet>( it, last ) - data);
+                    break;
+                }
+
+                if( special == last )
+                    return static_cast<size_t>( header - data );
+
+                if( *special == TAlphabet::header )
+                {
+                    next = special;
+                    break;
+                }
+
+                if( *special == TAlphabet::footer )
+                {
+                    it = special;
+                    break;
+                }
+
+                // An escape
+                if( special + 1 == last )
+                    return static_cast<size_t>( header - data );
+
+                if( special[1] == TAlphabet::header )
+                {
+                    next = special + 1;
+                    break;
+                }
+
+                if( ++length > maxSize )
+                {
+                    next = data + (detail::findHeader<TAlphabet>( special + 2, last ) - data);
+                    break;
+                }
+
+                it = special + 2;
+            }
+
+            if( next != nullptr )
+            {
+                header = next;
+                continue;
+            }
+
+            // Unescape [header + 1, it) over itself
+            uint8_t* const footer = it;
+            uint8_t* out = header + 1;
+            for( it = header + 1; it != footer; )
+            {
+                const uint8_t* special = detail::findSpecial<TAlphabet>( it, footer );
+                const size_t run = static_cast<size_t>( special - it );
+
+                if( out != it )
+                    memmove( out, it, run );
+                out += run;
+                it += run;
+
+                if( it != footer )
+                {
+                    *out++ = it[1] ^ TAlphabet::xorMask;
+                    it += 2;
+                }
+            }
+
+            frames[count++] = Span { header + 1, length };
+            header = data + (detail::findHeader<TAlphabet>( footer + 1, last ) - data);
+        }
+
+        return static_cast<size_t>( header - data );
+    }
+
+    // The transmit half of the Bicoder : the buffer holds exactly one encoded
+    // message of up to NMaxMessage payload bytes.
+    template<uint32_t NMaxMessage = 10, typename TSize = uint8_t, typename TAlphabet = DefaultAlphabet>
+    struct Encoder
+    {
+        static_assert( (0U < NMaxMessage) and (2ULL * NMaxMessage + 2U <= static_cast<TSize>( -1 )),
+                       "The max length of the message is out of range" );
+
+        static constexpr TSize maxEncodedSize = static_cast<TSize>( proto::maxEncodedSize( NMaxMessage ) );
+
+        Encoder() = default;
+
+        bool            encodeMessage( const uint8_t* data, TSize size );
+        void            reset() { m_index = 0; }
+        bool            isCompleted() const { return m_index != 0; }
+        TSize           size() const { return m_index; }
+        const uint8_t*  buff() const { return m_message; }
+
+        // Encode into the caller's storage, the internal buffer is left intact.
+        // Return the number of bytes written or 0 if the message is too long
+        // or the output is too small (its content is unspecified then). The
+        // output may be larger than TSize can count.
+        static TSize    encodeMessage( const uint8_t* data, TSize size, uint8_t* out, size_t capacity );
+
+        // Returns the iterator past the last byte written, out if the message is too long
+        template<typename TOutputIt>
+        static TOutputIt encodeMessage( const uint8_t* data, TSize size, TOutputIt out );
+
+        // TSink provides bool write( const uint8_t* data, size_t size ) returning
+        // false when it is full. The pointers passed point into the payload or into
+        // static storage and stay valid after the call.
+        template<typename TSink>
+        static bool     writeMessage( const uint8_t* data, TSize size, TSink& sink );
 
+        // The same for a message made of several segments, as if they were
+        // concatenated. Their total size must not exceed NMaxMessage.
+        bool            encodeMessage( const Span* segments, size_t count );
+        static TSize    encodeMessage( const Span* segments, size_t count, uint8_t* out, size_t capacity );
+
+        template<typename TSink>
+        static bool     writeMessage( const Span* segments, size_t count, TSink& sink );
+
+        // Encodes the payloads back to back into out, e.g. to send a burst with
+        // one write(). The i-th message starts at offsets[i] and offsets[n] is
+        // the end of the last one, so offsets takes count + 1 entries. Stops at a
+        // payload which is too long or doesn't fit. Returns the number n encoded.
+        static size_t   encodeBatch( const Span* payloads, size_t count, uint8_t* out, size_t capacity, size_t* offsets );
+
+        private :
+            uint8_t     m_message[maxEncodedSize] = { 0 };
+            TSize       m_index { 0 };
+    };
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    bool Encoder<N, TSize, TAlphabet>::encodeMessage( const uint8_t* data, TSize size )
+    {
+        m_index = encodeMessage( data, size, m_message, maxEncodedSize );
+
+        return m_index != 0;
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    TSize Encoder<N, TSize, TAlphabet>::encodeMessage( const uint8_t* data, TSize size, uint8_t* out, size_t capacity )
+    {
+        detail::BufferSink sink { out, capacity, 0 };
+
+        if( not writeMessage( data, size, sink ) )
+            return 0;
+
+        return static_cast<TSize>( sink.size );
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    template<typename TOutputIt>
+    TOutputIt Encoder<N, TSize, TAlphabet>::encodeMessage( const uint8_t* data, TSize size, TOutputIt out )
+    {
+        detail::IteratorSink<TOutputIt> sink { out };
+
+        writeMessage( data, size, sink );
+
+        return sink.out;
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    template<typename TSink>
+    bool Encoder<N, TSize, TAlphabet>::writeMessage( const uint8_t* data, TSize size, TSink& sink )
+    {
         if( N < size )
             return false;
 
-        m_message[m_index++] = ESpecial::eHDR;
+        return detail::encodeFrame<TAlphabet>( data, size, sink );
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    size_t Encoder<N, TSize, TAlphabet>::encodeBatch( const Span* payloads, size_t count, uint8_t* out, size_t capacity, size_t* offsets )
+    {
+        detail::BufferSink sink { out, capacity, 0 };
+        size_t i = 0;
+
+        for( ; i < count; ++i )
+        {
+            offsets[i] = sink.size;
 
-        for( uint8_t i = 0; i < size; ++i )
-            encodeByte( data[i] );
+            if( (N < payloads[i].size) or not detail::encodeFrame<TAlphabet>( payloads[i].data, payloads[i].size, sink ) )
+                break;
+        }
 
-        m_message[m_index++] = ESpecial::eFTR;
+        offsets[i] = (i < count) ? offsets[i] : sink.size;
 
-        return m_isCompleted = true;
+        return i;
     }
 
-    template<uint8_t N>
-    bool Bicoder<N>::waitHeader( const uint8_t data )
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    bool Encoder<N, TSize, TAlphabet>::encodeMessage( const Span* segments, size_t count )
     {
-        reset();
+        m_index = encodeMessage( segments, count, m_message, maxEncodedSize );
 
-        if( data == ESpecial::eHDR )
-            m_state = &Bicoder::inMessage;
+        return m_index != 0;
+    }
 
-        return true;
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    TSize Encoder<N, TSize, TAlphabet>::encodeMessage( const Span* segments, size_t count, uint8_t* out, size_t capacity )
+    {
+        detail::BufferSink sink { out, capacity, 0 };
+
+        if( not writeMessage( segments, count, sink ) )
+            return 0;
+
+        return static_cast<TSize>( sink.size );
     }
 
-    template<uint8_t N>
-    bool Bicoder<N>::inMessage( const uint8_t data )
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    template<typename TSink>
+    bool Encoder<N, TSize, TAlphabet>::writeMessage( const Span* segments, size_t count, TSink& sink )
     {
-        switch( data )
+        if( N < detail::totalSize( segments, count ) )
+            return false;
+
+        return detail::encodeFrame<TAlphabet>( segments, count, sink );
+    }
+
+    // An Encoder and a Decoder in one object. buff(), size() and isCompleted()
+    // refer to whichever of them was used last.
+    template<uint32_t NMaxMessage = 10, typename TSize = uint8_t, typename TAlphabet = DefaultAlphabet>
+    struct Bicoder
+    {
+        static constexpr TSize maxEncodedSize = Encoder<NMaxMessage, TSize, TAlphabet>::maxEncodedSize;
+
+        Bicoder() = default;
+
+        EDecodeResult   decode( const uint8_t data );
+        EDecodeResult   decode( const uint8_t* data, size_t size, size_t& consumed );
+        bool            decodeByte( const uint8_t data );
+        bool            decodeMessage( const uint8_t* data, TSize size );
+        size_t          decodeChunk( const uint8_t* data, size_t size );
+        bool            encodeMessage( const uint8_t* data, TSize size );
+        void            reset();
+        bool            isCompleted() const;
+        TSize           size() const;
+        const uint8_t*  buff() const;
+        uint32_t        resyncs() const { return m_decoder.resyncs(); }
+
+        // See Encoder
+        static TSize    encodeMessage( const uint8_t* data, TSize size, uint8_t* out, size_t capacity )
         {
-            case ESpecial::eFTR :
-                m_state = &Bicoder::waitHeader;
-                m_isCompleted = true;
-                return true;
-            case ESpecial::eESC :
-                m_state = &Bicoder::afterEscape;
-                return true;
-            case ESpecial::eHDR :
-                reset();
-                return false;
-            default :
-                return pushByte( data );
+            return Encoder_t::encodeMessage( data, size, out, capacity );
         }
+
+        template<typename TOutputIt>
+        static TOutputIt encodeMessage( const uint8_t* data, TSize size, TOutputIt out )
+        {
+            return Encoder_t::encodeMessage( data, size, out );
+        }
+
+        template<typename TSink>
+        static bool     writeMessage( const uint8_t* data, TSize size, TSink& sink )
+        {
+            return Encoder_t::writeMessage( data, size, sink );
+        }
+
+        bool            encodeMessage( const Span* segments, size_t count );
+
+        static size_t   encodeBatch( const Span* payloads, size_t count, uint8_t* out, size_t capacity, size_t* offsets )
+        {
+            return Encoder_t::encodeBatch( payloads, count, out, capacity, offsets );
+        }
+
+        static TSize    encodeMessage( const Span* segments, size_t count, uint8_t* out, size_t capacity )
+        {
+            return Encoder_t::encodeMessage( segments, count, out, capacity );
+        }
+
+        template<typename TSink>
+        static bool     writeMessage( const Span* segments, size_t count, TSink& sink )
+        {
+            return Encoder_t::writeMessage( segments, count, sink );
+        }
+
+        private :
+            using Encoder_t = Encoder<NMaxMessage, TSize, TAlphabet>;
+
+            Encoder<NMaxMessage, TSize, TAlphabet>  m_encoder;
+            Decoder<NMaxMessage, TSize, TAlphabet>  m_decoder;
+            bool                                    m_isEncoding { false };
+    };
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    void Bicoder<N, TSize, TAlphabet>::reset()
+    {
+        m_encoder.reset();
+        m_decoder.reset();
+        m_isEncoding = false;
     }
 
-    template<uint8_t N>
-    bool Bicoder<N>::afterEscape( const uint8_t data )
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    EDecodeResult Bicoder<N, TSize, TAlphabet>::decode( const uint8_t data )
     {
-        m_state = &Bicoder::inMessage;
-        pushByte( data ^ ESpecial::eXOR );
-        return true;
+        m_isEncoding = false;
+        return m_decoder.decode( data );
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    EDecodeResult Bicoder<N, TSize, TAlphabet>::decode( const uint8_t* data, size_t size, size_t& consumed )
+    {
+        m_isEncoding = false;
+        return m_decoder.decode( data, size, consumed );
     }
-}// proto
 
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    bool Bicoder<N, TSize, TAlphabet>::decodeByte( const uint8_t data )
+    {
+        m_isEncoding = false;
+        return m_decoder.decodeByte( data );
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    bool Bicoder<N, TSize, TAlphabet>::decodeMessage( const uint8_t* data, TSize size )
+    {
+        m_isEncoding = false;
+        return m_decoder.decodeMessage( data, size );
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    size_t Bicoder<N, TSize, TAlphabet>::decodeChunk( const uint8_t* data, size_t size )
+    {
+        m_isEncoding = false;
+        return m_decoder.decodeChunk( data, size );
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    bool Bicoder<N, TSize, TAlphabet>::encodeMessage( const uint8_t* data, TSize size )
+    {
+        m_isEncoding = true;
+        return m_encoder.encodeMessage( data, size );
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    bool Bicoder<N, TSize, TAlphabet>::encodeMessage( const Span* segments, size_t count )
+    {
+        m_isEncoding = true;
+        return m_encoder.encodeMessage( segments, count );
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    bool Bicoder<N, TSize, TAlphabet>::isCompleted() const
+    {
+        return m_isEncoding ? m_encoder.isCompleted() : m_decoder.isCompleted();
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    TSize Bicoder<N, TSize, TAlphabet>::size() const
+    {
+        return m_isEncoding ? m_encoder.size() : m_decoder.size();
+    }
+
+    template<uint32_t N, typename TSize, typename TAlphabet>
+    const uint8_t* Bicoder<N, TSize, TAlphabet>::buff() const
+    {
+        return m_isEncoding ? m_encoder.buff() : m_decoder.buff();
+    }
+}// proto
@@ -0,0 +1,187 @@
+#pragma once
+
+// Decoding of large captures on several threads (host only)
+
+#include <vector>
+#include <thread>
+#include <memory>
+#include <utility>
+
+#include "DataLinkSerialProtocol.h"
+
+namespace proto
+{
+    namespace detail
+    {
+        // Leaves the elements uninitialized on resize(), for vectors whose
+        // elements are all written afterwards
+        template<typename T>
+        struct UninitializedAllocator : std::allocator<T>
+        {
+            template<typename U>
+            struct rebind { using other = UninitializedAllocator<U>; };
+
+            UninitializedAllocator() = default;
+            template<typename U>
+            UninitializedAllocator( const UninitializedAllocator<U>& ) {}
+
+            template<typename U>
+            void construct( U* p ) { ::new( static_cast<void*>( p ) ) U; }
+
+            template<typename U, typename... TArgs>
+            void construct( U* p, TArgs&&... args ) { ::new( static_cast<void*>( p ) ) U( std::forward<TArgs>( args )... ); }
+        };
+
+        template<typename T>
+        using UninitializedVector = std::vector<T, UninitializedAllocator<T>>;
+    }// detail
+
+    // The messages of a capture in order, as a structure of arrays like
+    // FrameTable. The i-th message was encoded in encodedLength[i] bytes
+    // starting with its header at source[i] of the capture. status[i] is
+    // eFrameReady and its payload takes length[i] bytes at offset[i] of the
+    // arena, or eError/eOverflow for a lost message (which takes no bytes).
+    struct DecodedCapture
+    {
+        detail::UninitializedVector<uint8_t>        arena;
+        detail::UninitializedVector<size_t>         offset;
+        detail::UninitializedVector<uint32_t>       length;
+        detail::UninitializedVector<EDecodeResult>  status;
+        detail::UninitializedVector<size_t>         source;
+        detail::UninitializedVector<size_t>         encodedLength;
+
+        size_t                                      size() const { return status.size(); }
+    };
+
+    namespace detail
+    {
+        // Where the messages of a shard go in the DecodedCapture
+        struct ShardExtent
+        {
+            size_t      messages;
+            size_t      bytes;
+        };
+
+        // Counts the messages of [first, last) of data, which starts at a
+        // header (or is empty), and their decoded bytes
+        template<typename TDecoder>
+        void countShard( const uint8_t* data, size_t first, size_t last, ShardExtent& extent )
+        {
+            TDecoder decoder;
+
+            extent = ShardExtent { 0, 0 };
+            extent.messages = decodeMessages( decoder, data + first, last - first,
+                                              [&]( EDecodeResult result, size_t, size_t )
+            {
+                if( result == eFrameReady )
+                    extent.bytes += decoder.size();
+            } );
+        }
+
+        // Decodes the same messages again into their place in out, starting at
+        // the message and arena offset of the shard
+        template<typename TDecoder>
+        void decodeShard( const uint8_t* data, size_t first, size_t last, ShardExtent start, DecodedCapture& out )
+        {
+            TDecoder decoder;
+
+            decodeMessages( decoder, data + first, last - first,
+                            [&]( EDecodeResult result, size_t header, size_t encodedLength )
+            {
+                const size_t i = start.messages++;
+                const size_t length = (result == eFrameReady) ? decoder.size() : 0U;
+
+                out.offset[i]           = start.bytes;
+                out.length[i]           = static_cast<uint32_t>( length );
+                out.status[i]           = result;
+                out.source[i]           = first + header;
+                out.encodedLength[i]    = encodedLength;
+
+                if( length != 0 )
+                    memcpy( out.arena.data() + start.bytes, decoder.buff(), length );
+                start.bytes += length;
+            } );
+        }
+
+        // Runs work( t, first, last ) on a thread for every shard which isn't
+        // empty. The t-th shard holds the messages whose header lies in
+        // [starts[t], starts[t + 1]) and runs up to the header of the next one
+        // (included, since it may abort the last message).
+        template<typename TWork>
+        void forEachShard( const std::vector<size_t>& starts, size_t size, TWork work )
+        {
+            std::vector<std::thread> threads;
+            for( size_t t = 0; t + 1 < starts.size(); ++t )
+            {
+                if( starts[t] == starts[t + 1] )
+                    continue;
+
+                const size_t last = (starts[t + 1] == size) ? size : starts[t + 1] + 1;
+                threads.emplace_back( work, t, starts[t], last );
+            }
+
+            for( std::thread& thread : threads )
+                thread.join();
+        }
+    }// detail
+
+    // Decodes a capture on nThreads threads (0 means one per core) with the
+    // same results as a single Decoder<NMaxMessage, TSize, TAlphabet> fed
+    // with the whole capture.
+    //
+    // A header is never escaped, so every header starts a message whatever
+    // precedes it. The capture is cut in equal shards and each thread decodes
+    // the messages whose header lies in its shard. The threads first count the
+    // messages and bytes of their shard, then decode it again straight into
+    // its place in the result, so nothing is copied or merged afterwards.
+    template<uint32_t NMaxMessage = 10, typename TSize = uint8_t, typename TAlphabet = DefaultAlphabet>
+    DecodedCapture decodeParallel( const uint8_t* data, size_t size, unsigned nThreads = 0 )
+    {
+        using Decoder_t = Decoder<NMaxMessage, TSize, TAlphabet>;
+
+        if( nThreads == 0 )
+            nThreads = std::thread::hardware_concurrency();
+        if( nThreads == 0 )
+            nThreads = 1;
+
+        // starts[t] is the first header at or after the t-th cut
+        std::vector<size_t> starts( nThreads + 1 );
+        for( unsigned t = 0; t < nThreads; ++t )
+        {
+            const size_t cut = size / nThreads * t + size % nThreads * t / nThreads;
+            starts[t] = static_cast<size_t>( detail::findHeader<TAlphabet>( data + cut, data + size ) - data );
+        }
+        starts[nThreads] = size;
+
+        std::vector<detail::ShardExtent> extents( nThreads, detail::ShardExtent { 0, 0 } );
+        detail::forEachShard( starts, size, [&]( size_t t, size_t first, size_t last )
+        {
+            detail::countShard<Decoder_t>( data, first, last, extents[t] );
+        } );
+
+        // The extents become where each shard starts
+        detail::ShardExtent total { 0, 0 };
+        for( detail::ShardExtent& extent : extents )
+        {
+            const detail::ShardExtent count = extent;
+            extent = total;
+            total.messages += count.messages;
+            total.bytes += count.bytes;
+        }
+
+        DecodedCapture capture;
+        capture.arena.resize( total.bytes );
+        capture.offset.resize( total.messages );
+        capture.length.resize( total.messages );
+        capture.status.resize( total.messages );
+        capture.source.resize( total.messages );
+        capture.encodedLength.resize( total.messages );
+
+        detail::forEachShard( starts, size, [&]( size_t t, size_t first, size_t last )
+        {
+            detail::decodeShard<Decoder_t>( data, first, last, extents[t], capture );
+        } );
+
+        return capture;
+    }
+}// proto
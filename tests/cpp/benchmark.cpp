@@ -0,0 +1,419 @@
+// Throughput of the encoder and the decoder as JSON, e.g.
+//     make -s bench > bench.json
+// Every case is timed a few times and the best run is kept. Where the
+// hardware counters can be read (Linux, perf_event_paranoid <= 2 and a PMU
+// visible to the process) they are reported per byte as well, null otherwise.
+
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "DataLinkSerialProtocol.h"
+
+using namespace proto;
+
+constexpr uint16_t maxN = 1024;
+constexpr uint8_t streamN = 126;
+
+using Encoder_t = Encoder<maxN, uint16_t>;
+using Decoder_t = Decoder<maxN, uint16_t>;
+
+uint32_t nextRandom( uint32_t& seed )
+{
+    seed = seed * 1664525U + 1013904223U;
+    return seed >> 8;
+}
+
+// Back-to-back payloads of the same size, density percent of their bytes special
+struct Workload_t
+{
+    size_t                  payloadSize;
+    int                     density;
+    size_t                  frames;
+    std::vector<uint8_t>    payloads;
+    std::vector<uint8_t>    stream;
+    std::vector<size_t>     offsets;    // Of the encoded frames, one more than frames
+};
+
+Workload_t makeWorkload( size_t payloadSize, int density )
+{
+    Workload_t workload { payloadSize, density, std::max<size_t>( 1, (1U << 20) / payloadSize ), {}, {}, {} };
+    uint32_t seed = static_cast<uint32_t>( payloadSize * 101 + density );
+
+    workload.payloads.resize( workload.frames * payloadSize );
+    for( uint8_t& b : workload.payloads )
+    {
+        if( int( nextRandom( seed ) % 100 ) < density )
+            b = static_cast<uint8_t>( ESpecial::eHDR + nextRandom( seed ) % 3 );
+        else
+        {
+            do
+                b = static_cast<uint8_t>( nextRandom( seed ) );
+            while( detail::isSpecial( b ) );
+        }
+    }
+
+    uint8_t frame[Encoder_t::maxEncodedSize];
+    for( size_t f = 0; f < workload.frames; ++f )
+    {
+        const uint16_t n = Encoder_t::encodeMessage( workload.payloads.data() + f * payloadSize,
+                                                     static_cast<uint16_t>( payloadSize ), frame, sizeof(frame) );
+        workload.offsets.push_back( workload.stream.size() );
+        workload.stream.insert( workload.stream.end(), frame, frame + n );
+    }
+    workload.offsets.push_back( workload.stream.size() );
+
+    return workload;
+}
+
+// The noisy stream of the tests : good frames, truncated frames, garbage and
+// long frames. Every frame is cut short by the next header if resync is set.
+std::vector<uint8_t> makeNoisyStream( uint32_t seed, size_t nFrames, bool resync )
+{
+    std::vector<uint8_t> stream;
+
+    for( size_t f = 0; f < nFrames; ++f )
+    {
+        const uint32_t kind = nextRandom( seed ) % 8;
+
+        for( uint32_t g = nextRandom( seed ) % 4; g > 0; --g )
+            stream.push_back( static_cast<uint8_t>( nextRandom( seed ) ) );
+
+        stream.push_back( ESpecial::eHDR );
+
+        const uint32_t len = nextRandom( seed ) % (2U * streamN + 8U);
+        for( uint32_t i = 0; i < len; ++i )
+        {
+            const uint32_t r = nextRandom( seed ) % 64;
+            const uint8_t  b = (r < 3) ? static_cast<uint8_t>( ESpecial::eHDR + r ) : static_cast<uint8_t>( r * 7 );
+
+            if( detail::isSpecial( b ) and (kind != 0) )
+            {
+                stream.push_back( ESpecial::eESC );
+                stream.push_back( b ^ ESpecial::eXOR );
+            }
+            else
+                stream.push_back( b );
+        }
+
+        if( (kind != 1) and not resync )
+            stream.push_back( ESpecial::eFTR );
+    }
+
+    return stream;
+}
+
+// The decoders are long-lived and their output is summed into a checksum so
+// that the writes to the buffers can't be optimized away
+template<typename TDecoder>
+size_t decodeBytewise( TDecoder& decoder, const std::vector<uint8_t>& stream )
+{
+    size_t total = 0;
+
+    for( const uint8_t b : stream )
+    {
+        decoder.decodeByte( b );
+        if( decoder.isCompleted() and (decoder.size() != 0) )
+            total += decoder.size() + decoder.buff()[decoder.size() - 1];
+    }
+
+    return total;
+}
+
+template<typename TDecoder>
+size_t decodeChunkwise( TDecoder& decoder, const std::vector<uint8_t>& stream )
+{
+    size_t total = 0;
+    size_t offset = 0;
+
+    while( offset < stream.size() )
+    {
+        offset += decoder.decodeChunk( stream.data() + offset, stream.size() - offset );
+        if( decoder.isCompleted() and (decoder.size() != 0) )
+            total += decoder.size() + decoder.buff()[decoder.size() - 1];
+    }
+
+    return total;
+}
+
+size_t countFrames( const std::vector<uint8_t>& stream )
+{
+    Decoder<streamN> decoder;
+    size_t frames = 0;
+
+    for( const uint8_t b : stream )
+        frames += (decoder.decode( b ) == eFrameReady) ? 1U : 0U;
+
+    return frames;
+}
+
+// The hardware counters of the calling thread, user space only. A counter
+// which can't be opened reads as a negative value.
+struct PerfCounters
+{
+    enum ECounter
+    {
+        eCycles,
+        eInstructions,
+        eBranchMisses,
+        eL1dMisses,
+        eCount,
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    bool    isAvailable() const;
+    void    start();
+    void    stop( double* values ) const;   // eCount values
+
+    private :
+        int     m_fd[eCount];
+};
+
+PerfCounters::PerfCounters()
+{
+#if defined(__linux__)
+    const uint32_t types[eCount] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+    const uint64_t configs[eCount] =
+    {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    };
+
+    for( int c = 0; c < eCount; ++c )
+    {
+        perf_event_attr attr;
+        memset( &attr, 0, sizeof(attr) );
+        attr.size           = sizeof(attr);
+        attr.type           = types[c];
+        attr.config         = configs[c];
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        m_fd[c] = static_cast<int>( syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 ) );
+    }
+#else
+    for( int c = 0; c < eCount; ++c )
+        m_fd[c] = -1;
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#if defined(__linux__)
+    for( int c = 0; c < eCount; ++c )
+    {
+        if( m_fd[c] >= 0 )
+            close( m_fd[c] );
+    }
+#endif
+}
+
+bool PerfCounters::isAvailable() const
+{
+    return std::any_of( m_fd, m_fd + eCount, []( int fd ) { return fd >= 0; } );
+}
+
+void PerfCounters::start()
+{
+#if defined(__linux__)
+    for( int c = 0; c < eCount; ++c )
+    {
+        if( m_fd[c] >= 0 )
+        {
+            ioctl( m_fd[c], PERF_EVENT_IOC_RESET, 0 );
+            ioctl( m_fd[c], PERF_EVENT_IOC_ENABLE, 0 );
+        }
+    }
+#endif
+}
+
+// The counts are scaled up if the counters were multiplexed
+void PerfCounters::stop( double* values ) const
+{
+    for( int c = 0; c < eCount; ++c )
+    {
+        values[c] = -1;
+#if defined(__linux__)
+        if( m_fd[c] < 0 )
+            continue;
+
+        ioctl( m_fd[c], PERF_EVENT_IOC_DISABLE, 0 );
+
+        uint64_t data[3];   // value, time enabled, time running
+        if( (read( m_fd[c], data, sizeof(data) ) == sizeof(data)) and (data[2] != 0) )
+            values[c] = double( data[0] ) * double( data[1] ) / double( data[2] );
+#endif
+    }
+}
+
+PerfCounters perfCounters;
+
+struct Timing_t
+{
+    double  ns;                                 // Of the best run
+    size_t  checksum;
+    double  counters[PerfCounters::eCount];     // Of the best run, negative if unknown
+};
+
+template<typename TFunction>
+Timing_t measure( TFunction function )
+{
+    constexpr int nRepetitions = 3;
+    constexpr double minNs = 2e7;
+
+    Timing_t best { 1e300, 0, { -1, -1, -1, -1 } };
+    for( int rep = 0; rep < nRepetitions; ++rep )
+    {
+        int runs = 0;
+        double ns = 0;
+        double counters[PerfCounters::eCount];
+
+        perfCounters.start();
+        const auto start = std::chrono::steady_clock::now();
+        do
+        {
+            best.checksum = function();
+            ++runs;
+            ns = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count();
+        }
+        while( ns < minNs );
+        perfCounters.stop( counters );
+
+        if( ns / runs < best.ns )
+        {
+            best.ns = ns / runs;
+            for( int c = 0; c < PerfCounters::eCount; ++c )
+                best.counters[c] = (counters[c] < 0) ? -1 : counters[c] / runs;
+        }
+    }
+
+    return best;
+}
+
+// Prints one result as a JSON object, size and density are null if negative
+void printResult( const char* scenario, const char* operation, long payloadSize, int density,
+                  size_t inputBytes, size_t frames, const Timing_t& timing, bool first )
+{
+    const auto orNull = []( long value ) { return (value < 0) ? std::string( "null" ) : std::to_string( value ); };
+    const auto perByte = [&]( int c )
+    {
+        return (timing.counters[c] < 0) ? std::string( "null" ) : std::to_string( timing.counters[c] / inputBytes );
+    };
+    const bool hasIpc = (timing.counters[PerfCounters::eCycles] > 0) and (timing.counters[PerfCounters::eInstructions] >= 0);
+
+    std::cout << (first ? "\n" : ",\n")
+              << "    { \"scenario\": \"" << scenario << "\", \"operation\": \"" << operation << "\""
+              << ", \"payload_size\": " << orNull( payloadSize )
+              << ", \"density_percent\": " << orNull( density )
+              << ", \"input_bytes\": " << inputBytes
+              << ", \"frames\": " << frames
+              << ", \"mb_per_s\": " << inputBytes / timing.ns * 1e3
+              << ", \"ns_per_byte\": " << timing.ns / inputBytes
+              << ", \"ns_per_frame\": " << (frames ? timing.ns / frames : 0.0)
+              << ", \"cycles_per_byte\": " << perByte( PerfCounters::eCycles )
+              << ", \"instructions_per_byte\": " << perByte( PerfCounters::eInstructions )
+              << ", \"ipc\": " << (hasIpc ? std::to_string( timing.counters[PerfCounters::eInstructions] /
+                                                             timing.counters[PerfCounters::eCycles] ) : std::string( "null" ))
+              << ", \"branch_misses_per_byte\": " << perByte( PerfCounters::eBranchMisses )
+              << ", \"l1d_misses_per_byte\": " << perByte( PerfCounters::eL1dMisses )
+              << ", \"checksum\": " << timing.checksum << " }";
+}
+
+int main()
+{
+    const size_t payloadSizes[] = { 1, 16, 126, 1024 };
+    const int densities[] = { 0, 1, 50, 100 };
+
+    Encoder_t encoder;
+    Decoder_t decoder;
+    bool first = true;
+
+    std::cout << "{\n  \"sizeof\": { \"Encoder<1024, uint16_t>\": " << sizeof(Encoder_t)
+              << ", \"Decoder<1024, uint16_t>\": " << sizeof(Decoder_t)
+              << ", \"Bicoder<126>\": " << sizeof(Bicoder<streamN>) << " },\n"
+              << "  \"perf_counters\": " << (perfCounters.isAvailable() ? "true" : "false") << ",\n  \"results\": [";
+
+    // The input of the encoder is the payloads, the input of the decoder the frames
+    for( const size_t payloadSize : payloadSizes )
+    {
+        for( const int density : densities )
+        {
+            const Workload_t w = makeWorkload( payloadSize, density );
+            const uint16_t size = static_cast<uint16_t>( payloadSize );
+
+            const Timing_t encoding = measure( [&]()
+            {
+                size_t total = 0;
+                for( size_t f = 0; f < w.frames; ++f )
+                {
+                    encoder.encodeMessage( w.payloads.data() + f * payloadSize, size );
+                    total += encoder.size() + encoder.buff()[encoder.size() - 2];
+                }
+                return total;
+            } );
+            printResult( "frames", "encodeMessage", long( payloadSize ), density, w.payloads.size(), w.frames, encoding, first );
+            first = false;
+
+            const Timing_t message = measure( [&]()
+            {
+                size_t total = 0;
+                for( size_t f = 0; f < w.frames; ++f )
+                {
+                    decoder.decodeMessage( w.stream.data() + w.offsets[f], static_cast<uint16_t>( w.offsets[f + 1] - w.offsets[f] ) );
+                    total += decoder.size() + decoder.buff()[decoder.size() - 1];
+                }
+                return total;
+            } );
+            printResult( "frames", "decodeMessage", long( payloadSize ), density, w.stream.size(), w.frames, message, first );
+
+            const Timing_t bytewise = measure( [&]() { return decodeBytewise( decoder, w.stream ); } );
+            printResult( "frames", "decodeByte", long( payloadSize ), density, w.stream.size(), w.frames, bytewise, first );
+
+            const Timing_t chunkwise = measure( [&]() { return decodeChunkwise( decoder, w.stream ); } );
+            printResult( "frames", "decodeChunk", long( payloadSize ), density, w.stream.size(), w.frames, chunkwise, first );
+        }
+    }
+
+    // The streams of the tests : frames only, with noise, or aborted by headers
+    struct Stream_t
+    {
+        const char*             scenario;
+        std::vector<uint8_t>    stream;
+    };
+
+    const Stream_t streams[] =
+    {
+        { "noisy", makeNoisyStream( 1, 20000, false ) },
+        { "resync", makeNoisyStream( 2, 20000, true ) },
+    };
+
+    Decoder<streamN> streamDecoder;
+    for( const Stream_t& s : streams )
+    {
+        const size_t frames = countFrames( s.stream );
+
+        const Timing_t bytewise = measure( [&]() { return decodeBytewise( streamDecoder, s.stream ); } );
+        printResult( s.scenario, "decodeByte", -1, -1, s.stream.size(), frames, bytewise, first );
+
+        const Timing_t chunkwise = measure( [&]() { return decodeChunkwise( streamDecoder, s.stream ); } );
+        printResult( s.scenario, "decodeChunk", -1, -1, s.stream.size(), frames, chunkwise, first );
+    }
+
+    std::cout << "\n  ]\n}\n";
+}
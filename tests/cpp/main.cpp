@@ -1,8 +1,15 @@
 #include <iostream>
 #include <algorithm>
 #include <cassert>
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <type_traits>
+
+#include <sys/uio.h>
 
 #include "DataLinkSerialProtocol.h"
+#include "DataLinkSerialProtocolParallel.h"
 
 bool compareBuffers( const uint8_t* buff1, uint8_t size1,
                      const uint8_t* buff2, uint8_t size2 )
@@ -21,6 +28,162 @@ bool compareBuffers( const uint8_t* buff1, uint8_t size1,
 
 using namespace proto;
 
+constexpr uint8_t constantPayload[] = { 1, ESpecial::eFTR, 2, ESpecial::eESC };
+
+template<size_t N>
+constexpr bool sameBytes( const std::array<uint8_t, N>& a, const std::array<uint8_t, N>& b )
+{
+    for( size_t i = 0; i < N; ++i )
+    {
+        if( a[i] != b[i] )
+            return false;
+    }
+    return true;
+}
+
+// The layout of Decoder<N> : the buffer pointer, the resync counter, the
+// capacity, the index and the state, followed by the N bytes of its buffer
+constexpr size_t alignToPointer( size_t size )
+{
+    return (size + alignof(uint8_t*) - 1) / alignof(uint8_t*) * alignof(uint8_t*);
+}
+
+constexpr size_t decoderSize( size_t n )
+{
+    return alignToPointer( sizeof(uint8_t*) + sizeof(uint32_t) + 3 + n );
+}
+
+using Frame_t = std::vector<uint8_t>;
+
+// A tiny deterministic generator (no <random> to keep the output stable)
+uint32_t nextRandom( uint32_t& seed )
+{
+    seed = seed * 1664525U + 1013904223U;
+    return seed >> 8;
+}
+
+// A noisy stream : good frames, truncated frames, garbage and long frames
+std::vector<uint8_t> makeNoisyStream( uint32_t seed, size_t nFrames, uint8_t maxN )
+{
+    std::vector<uint8_t> stream;
+
+    for( size_t f = 0; f < nFrames; ++f )
+    {
+        const uint32_t kind = nextRandom( seed ) % 8;
+
+        for( uint32_t g = nextRandom( seed ) % 4; g > 0; --g )
+            stream.push_back( static_cast<uint8_t>( nextRandom( seed ) ) );
+
+        stream.push_back( ESpecial::eHDR );
+
+        const uint32_t len = nextRandom( seed ) % (2U * maxN + 8U);
+        for( uint32_t i = 0; i < len; ++i )
+        {
+            const uint32_t r = nextRandom( seed ) % 64;
+            const uint8_t  b = (r < 3) ? static_cast<uint8_t>( ESpecial::eHDR + r ) : static_cast<uint8_t>( r * 7 );
+
+            if( detail::isSpecial( b ) and (kind != 0) )
+            {
+                stream.push_back( ESpecial::eESC );
+                stream.push_back( b ^ ESpecial::eXOR );
+            }
+            else
+                stream.push_back( b );
+        }
+
+        if( kind != 1 )
+            stream.push_back( ESpecial::eFTR );
+    }
+
+    return stream;
+}
+
+template<typename TDecoder>
+std::vector<Frame_t> decodeBytewise( const std::vector<uint8_t>& stream )
+{
+    TDecoder bicoder;
+    std::vector<Frame_t> frames;
+
+    for( const uint8_t b : stream )
+    {
+        bicoder.decodeByte( b );
+        if( bicoder.isCompleted() )
+        {
+            frames.emplace_back( bicoder.buff(), bicoder.buff() + bicoder.size() );
+            bicoder.reset();
+        }
+    }
+
+    return frames;
+}
+
+using Event_t = std::pair<EDecodeResult, Frame_t>;
+
+// Everything but eNeedMore, byte by byte if chunk is 0
+template<typename TDecoder>
+std::vector<Event_t> decodeEvents( const std::vector<uint8_t>& stream, size_t chunk )
+{
+    TDecoder decoder;
+    std::vector<Event_t> events;
+
+    const auto onResult = [&]( EDecodeResult result )
+    {
+        if( result == eFrameReady )
+            events.emplace_back( result, Frame_t( decoder.buff(), decoder.buff() + decoder.size() ) );
+        else if( result != eNeedMore )
+            events.emplace_back( result, Frame_t() );
+    };
+
+    if( chunk == 0 )
+    {
+        for( const uint8_t b : stream )
+            onResult( decoder.decode( b ) );
+
+        return events;
+    }
+
+    for( size_t offset = 0; offset < stream.size(); offset += chunk )
+    {
+        const uint8_t* data = stream.data() + offset;
+        size_t size = std::min( chunk, stream.size() - offset );
+
+        while( size )
+        {
+            size_t consumed = 0;
+            onResult( decoder.decode( data, size, consumed ) );
+            data += consumed;
+            size -= consumed;
+        }
+    }
+
+    return events;
+}
+
+template<typename TDecoder>
+std::vector<Frame_t> decodeChunkwise( const std::vector<uint8_t>& stream, size_t chunk )
+{
+    TDecoder bicoder;
+    std::vector<Frame_t> frames;
+
+    for( size_t offset = 0; offset < stream.size(); offset += chunk )
+    {
+        const uint8_t* data = stream.data() + offset;
+        size_t size = std::min( chunk, stream.size() - offset );
+
+        while( size )
+        {
+            const size_t consumed = bicoder.decodeChunk( data, size );
+            data += consumed;
+            size -= consumed;
+
+            if( bicoder.isCompleted() )
+                frames.emplace_back( bicoder.buff(), bicoder.buff() + bicoder.size() );
+        }
+    }
+
+    return frames;
+}
+
 int main()
 {
     constexpr uint8_t maxN = 10;
@@ -112,6 +275,850 @@ int main()
         assert( numMsg == 3 );
     }
 
+    /****** Chunk decoding (mocking a stream) ******/
+    {
+        constexpr uint8_t msgStream[2] = { esc, hdr };
+
+        constexpr uint8_t msgStreamDoubleEnc[] =
+        {
+            0, 0, 0,
+            hdr, esc, (esc ^ x), esc, (hdr ^ x), ftr,
+            hdr, esc, (esc ^ x), esc, (hdr ^ x), ftr,
+            0,
+            hdr, esc, (esc ^ x), esc, (hdr ^ x), ftr,
+            0, 0, 0
+        };
+
+        bicoder.reset();
+        uint8_t numMsg = 0;
+        size_t offset = 0;
+        while( offset < sizeof(msgStreamDoubleEnc) )
+        {
+            offset += bicoder.decodeChunk( msgStreamDoubleEnc + offset, sizeof(msgStreamDoubleEnc) - offset );
+
+            if( bicoder.isCompleted() )
+            {
+                ++numMsg;
+                assert( compareBuffers( bicoder.buff(), bicoder.size(),
+                                        msgStream, sizeof(msgStream) ) );
+            }
+        }
+        assert( numMsg == 3 );
+    }
+
+    /****** Chunk decoding matches byte decoding ******/
+    {
+        for( uint32_t seed = 1; seed < 20; ++seed )
+        {
+            const std::vector<uint8_t> stream = makeNoisyStream( seed, 200, 100 );
+            const std::vector<Frame_t> expected = decodeBytewise<Bicoder<100>>( stream );
+
+            assert( not expected.empty() );
+            for( const size_t chunk : { size_t(1), size_t(7), size_t(64), size_t(4096) } )
+                assert( decodeChunkwise<Bicoder<100>>( stream, chunk ) == expected );
+
+            assert( decodeChunkwise<Bicoder<3>>( stream, 4096 ) == decodeBytewise<Bicoder<3>>( stream ) );
+        }
+
+        // Mostly escaped payloads, some too long, some with stray special bytes
+        std::vector<uint8_t> dense;
+        uint32_t seed = 7;
+        for( size_t f = 0; f < 100; ++f )
+        {
+            dense.push_back( hdr );
+            for( uint32_t i = nextRandom( seed ) % 250; i > 0; --i )
+            {
+                const uint32_t r = nextRandom( seed ) % 4;
+                if( r < 3 )
+                {
+                    dense.push_back( esc );
+                    dense.push_back( static_cast<uint8_t>( (hdr + r) ^ x ) );
+                }
+                else
+                    dense.push_back( static_cast<uint8_t>( nextRandom( seed ) ) );
+            }
+            dense.push_back( ftr );
+        }
+
+        const std::vector<Event_t> expected = decodeEvents<Decoder<100>>( dense, 0 );
+        assert( std::count_if( expected.begin(), expected.end(),
+                               []( const Event_t& e ) { return e.first == eFrameReady; } ) > 10 );
+        for( const size_t chunk : { size_t(1), size_t(7), size_t(64), size_t(4096) } )
+            assert( decodeEvents<Decoder<100>>( dense, chunk ) == expected );
+    }
+
+    /****** Decoder matches Bicoder ******/
+    {
+        static_assert( sizeof(Decoder<100>) == decoderSize( 100 ), "Decoder should hold N bytes and its state" );
+
+        for( uint32_t seed = 100; seed < 120; ++seed )
+        {
+            const std::vector<uint8_t> stream = makeNoisyStream( seed, 200, 100 );
+            const std::vector<Frame_t> expected = decodeBytewise<Bicoder<100>>( stream );
+
+            assert( decodeBytewise<Decoder<100>>( stream ) == expected );
+            assert( decodeChunkwise<Decoder<100>>( stream, 64 ) == expected );
+            assert( decodeBytewise<Decoder<5>>( stream ) == decodeBytewise<Bicoder<5>>( stream ) );
+        }
+
+        constexpr uint8_t msg[] = { hdr, esc, ftr, 0, 1, 2 };
+
+        Decoder<maxN> decoder;
+        assert( bicoder.encodeMessage( msg, sizeof(msg) ) );
+        assert( decoder.decodeMessage( bicoder.buff(), bicoder.size() ) );
+        assert( compareBuffers( decoder.buff(), decoder.size(), msg, sizeof(msg) ) );
+    }
+
+    /****** Encoding long payloads (vectorized runs) ******/
+    {
+        for( uint32_t seed = 1; seed < 100; ++seed )
+        {
+            uint8_t payload[100];
+            const uint8_t size = static_cast<uint8_t>( nextRandom( seed ) % (sizeof(payload) + 1) );
+            // Sixteenths of special bytes, up to every byte
+            constexpr uint32_t densities[] = { 0, 1, 3, 8, 16 };
+            const uint32_t density = densities[nextRandom( seed ) % 5];
+
+            for( uint8_t i = 0; i < size; ++i )
+            {
+                const uint32_t r = nextRandom( seed );
+                payload[i] = ((r % 16) < density) ? static_cast<uint8_t>( hdr + (r >> 4) % 3 ) : static_cast<uint8_t>( r );
+            }
+
+            Frame_t expected { hdr };
+            for( uint8_t i = 0; i < size; ++i )
+            {
+                if( detail::isSpecial( payload[i] ) )
+                {
+                    expected.push_back( esc );
+                    expected.push_back( payload[i] ^ x );
+                }
+                else
+                    expected.push_back( payload[i] );
+            }
+            expected.push_back( ftr );
+
+            Bicoder<100> lBicoder;
+            assert( lBicoder.encodeMessage( payload, size ) );
+            assert( compareBuffers( lBicoder.buff(), lBicoder.size(),
+                                    expected.data(), static_cast<uint8_t>( expected.size() ) ) );
+
+            // Through a sink and into a buffer with no room to spare
+            Frame_t viaSink;
+            lBicoder.encodeMessage( payload, size, std::back_inserter( viaSink ) );
+            assert( viaSink == expected );
+
+            Frame_t exact( expected.size() );
+            assert( Encoder<100>::encodeMessage( payload, size, exact.data(), exact.size() ) == expected.size() );
+            assert( exact == expected );
+
+            assert( lBicoder.decodeMessage( expected.data(), static_cast<uint8_t>( expected.size() ) ) );
+            assert( compareBuffers( lBicoder.buff(), lBicoder.size(), payload, size ) );
+        }
+    }
+
+    /****** Wide size types ******/
+    {
+        static_assert( sizeof(Bicoder<maxN>().size()) == 1, "The default size type is a byte" );
+        static_assert( Bicoder<126>::maxEncodedSize == 254, "" );
+        static_assert( Bicoder<4096, uint16_t>::maxEncodedSize == 8194, "" );
+
+        std::vector<uint8_t> payload( 4096 );
+        uint32_t seed = 7;
+        for( uint8_t& b : payload )
+            b = static_cast<uint8_t>( nextRandom( seed ) );
+        payload[0] = hdr; payload[4095] = ftr;
+
+        auto wBicoder = std::make_unique<Bicoder<4096, uint16_t>>();
+        assert( wBicoder->encodeMessage( payload.data(), 4096 ) );
+        assert( not wBicoder->encodeMessage( payload.data(), 4097 ) );
+
+        assert( wBicoder->encodeMessage( payload.data(), 4096 ) );
+        const Frame_t encoded( wBicoder->buff(), wBicoder->buff() + wBicoder->size() );
+
+        assert( wBicoder->decodeMessage( encoded.data(), static_cast<uint16_t>( encoded.size() ) ) );
+        assert( Frame_t( wBicoder->buff(), wBicoder->buff() + wBicoder->size() ) == payload );
+
+        auto wDecoder = std::make_unique<Decoder<4096, uint16_t>>();
+        assert( wDecoder->decodeChunk( encoded.data(), encoded.size() ) == encoded.size() );
+        assert( wDecoder->isCompleted() );
+        assert( Frame_t( wDecoder->buff(), wDecoder->buff() + wDecoder->size() ) == payload );
+
+        // A 1 MiB frame
+        payload.resize( 1U << 20, 0x55 );
+        auto hBicoder = std::make_unique<Bicoder<(1U << 20), uint32_t>>();
+        assert( hBicoder->encodeMessage( payload.data(), 1U << 20 ) );
+        const Frame_t hEncoded( hBicoder->buff(), hBicoder->buff() + hBicoder->size() );
+        assert( hBicoder->decodeMessage( hEncoded.data(), static_cast<uint32_t>( hEncoded.size() ) ) );
+        assert( Frame_t( hBicoder->buff(), hBicoder->buff() + hBicoder->size() ) == payload );
+    }
+
+    /****** Separate Encoder and Decoder ******/
+    {
+        static_assert( sizeof(Encoder<126>) == 255, "Encoder should hold 2N+2 bytes and the index" );
+        static_assert( sizeof(Decoder<126>) == decoderSize( 126 ), "Decoder should hold N bytes and its state" );
+        static_assert( sizeof(Decoder<maxN>) == decoderSize( maxN ), "Decoder should hold N bytes and its state" );
+        static_assert( sizeof(Bicoder<126>) == alignToPointer( alignToPointer( 255 ) + decoderSize( 126 ) + 1 ),
+                       "Bicoder should hold an Encoder, a Decoder and a flag" );
+        static_assert( sizeof(Bicoder<maxN>) == alignToPointer( alignToPointer( 2 * maxN + 3 ) + decoderSize( maxN ) + 1 ),
+                       "Bicoder should hold an Encoder, a Decoder and a flag" );
+
+        constexpr uint8_t msg[] = { 1, hdr, 2 };
+        constexpr uint8_t msgEnc[] = { hdr, 1, esc, (hdr ^ x), 2, ftr };
+
+        Encoder<maxN> encoder;
+        assert( not encoder.isCompleted() );
+        assert( encoder.encodeMessage( msg, sizeof(msg) ) );
+        assert( encoder.isCompleted() );
+        assert( compareBuffers( encoder.buff(), encoder.size(), msgEnc, sizeof(msgEnc) ) );
+
+        // Encoding in the middle of a received message doesn't disturb it
+        Bicoder<maxN> lBicoder;
+        for( uint8_t i = 0; i < 3; ++i )
+            assert( lBicoder.decodeByte( msgEnc[i] ) );
+        assert( lBicoder.encodeMessage( msg, sizeof(msg) ) );
+        assert( compareBuffers( lBicoder.buff(), lBicoder.size(), msgEnc, sizeof(msgEnc) ) );
+        for( uint8_t i = 3; i < sizeof(msgEnc); ++i )
+            assert( lBicoder.decodeByte( msgEnc[i] ) );
+        assert( lBicoder.isCompleted() );
+        assert( compareBuffers( lBicoder.buff(), lBicoder.size(), msg, sizeof(msg) ) );
+    }
+
+    /****** Encoding into the caller's storage ******/
+    {
+        constexpr uint8_t msg[] = { 1, hdr, 2, 3, ftr };
+        constexpr uint8_t msgEnc[] = { hdr, 1, esc, (hdr ^ x), 2, 3, esc, (ftr ^ x), ftr };
+
+        Encoder<maxN> encoder;
+        assert( encoder.encodeMessage( msg, 1 ) );
+
+        uint8_t out[sizeof(msgEnc)];
+        assert( Encoder<maxN>::encodeMessage( msg, sizeof(msg), out, sizeof(out) ) == sizeof(msgEnc) );
+        assert( compareBuffers( out, sizeof(out), msgEnc, sizeof(msgEnc) ) );
+        assert( Encoder<maxN>::encodeMessage( msg, sizeof(msg), out, sizeof(out) - 1 ) == 0 );
+        assert( Encoder<4>::encodeMessage( msg, sizeof(msg), out, sizeof(out) ) == 0 );
+        assert( encoder.size() == 3 ); // untouched
+
+        // A buffer larger than TSize can count
+        Frame_t large( 300 );
+        const uint8_t longMsg[126] = { hdr };
+        assert( Encoder<126>::encodeMessage( longMsg, sizeof(longMsg), large.data(), large.size() ) == sizeof(longMsg) + 1 + 2 );
+        assert( Bicoder<126>::encodeMessage( longMsg, sizeof(longMsg), large.data(), large.size() ) == sizeof(longMsg) + 1 + 2 );
+        assert( (large[0] == hdr) and (large[1] == esc) and (large[2] == (hdr ^ x)) );
+
+        Frame_t vec;
+        bicoder.encodeMessage( msg, sizeof(msg), std::back_inserter( vec ) );
+        assert( vec == Frame_t( msgEnc, msgEnc + sizeof(msgEnc) ) );
+
+        uint8_t* end = Encoder<maxN>::encodeMessage( msg, sizeof(msg), out );
+        assert( end == out + sizeof(msgEnc) );
+        assert( Encoder<4>::encodeMessage( msg, sizeof(msg), out ) == out );
+
+        // A sink which only records the pieces
+        struct Pieces
+        {
+            std::vector<std::pair<const uint8_t*, size_t>> pieces;
+            bool write( const uint8_t* data, size_t size )
+            {
+                pieces.emplace_back( data, size );
+                return pieces.size() < 6;
+            }
+        } pieces;
+
+        assert( not Encoder<maxN>::writeMessage( msg, sizeof(msg), pieces ) );
+        assert( pieces.pieces.size() == 6 );
+        assert( (pieces.pieces[1] == std::make_pair( msg + 0, size_t(1) )) );
+        assert( (pieces.pieces[3] == std::make_pair( msg + 2, size_t(2) )) );
+    }
+
+    /****** Decoding into the caller's buffers ******/
+    {
+        constexpr uint8_t msgStreamEnc[] =
+        {
+            0, hdr, 1, 2, ftr,
+            hdr, esc, (esc ^ x), 3, 4, ftr,
+            hdr, 5, 6, 7, 8, 9, ftr,
+            hdr, 10, ftr,
+            hdr, 11, ftr
+        };
+
+        uint8_t pool[3][maxN];
+        uint8_t nextBuffer = 0;
+        std::vector<std::pair<uint8_t*, uint8_t>> frames;
+
+        Decoder<maxN> decoder;
+        decoder.setFrameBuffer( pool[nextBuffer++], maxN );
+        bool isPooled = true;
+
+        size_t offset = 0;
+        while( offset < sizeof(msgStreamEnc) )
+        {
+            offset += decoder.decodeChunk( msgStreamEnc + offset, sizeof(msgStreamEnc) - offset );
+            if( not decoder.isCompleted() or not isPooled )
+                continue;
+
+            assert( decoder.buff() == pool[nextBuffer - 1] );
+
+            uint8_t size = 0;
+            uint8_t* frame = decoder.releaseFrame( size );
+            assert( frame == pool[nextBuffer - 1] );
+            frames.emplace_back( frame, size );
+
+            uint8_t none = 1;
+            assert( decoder.releaseFrame( none ) == nullptr );
+            assert( none == 0 );
+
+            // The last frame goes to the internal buffer
+            if( nextBuffer < 3 )
+                decoder.setFrameBuffer( pool[nextBuffer++], 4 );
+            else
+                isPooled = false;
+        }
+
+        // 5 bytes don't fit into 4 and are dropped
+        assert( frames.size() == 3 );
+        assert( compareBuffers( frames[0].first, frames[0].second, msgStreamEnc + 2, 2 ) );
+        assert( frames[1].second == 3 and frames[1].first[0] == esc and frames[1].first[2] == 4 );
+        assert( frames[2].first == pool[2] and frames[2].second == 1 and frames[2].first[0] == 10 );
+
+        // The internal buffer is used after the 3 buffers
+        assert( decoder.buff() != pool[2] );
+        assert( decoder.isCompleted() and (decoder.size() == 1) and (decoder.buff()[0] == 11) );
+        uint8_t size = 0;
+        assert( decoder.releaseFrame( size ) == nullptr );
+
+        // Copies keep their own internal buffer
+        Decoder<maxN> copy( decoder );
+        assert( copy.buff() != decoder.buff() );
+        assert( compareBuffers( copy.buff(), copy.size(), decoder.buff(), decoder.size() ) );
+
+        // A pool slot larger than TSize can count
+        uint8_t slot[256];
+        Decoder<126> large;
+        large.setFrameBuffer( slot, sizeof(slot) );
+        assert( large.capacity() == 126 );
+
+        // Only the decoder given the caller's buffer writes and releases it
+        Decoder<maxN> owner;
+        owner.setFrameBuffer( pool[0], maxN );
+        assert( owner.decodeMessage( msgStreamEnc + 1, 4 ) );
+
+        Decoder<maxN> other;
+        other = owner;
+        Decoder<maxN> copied( owner );
+        for( const Decoder<maxN>* d : { &other, &copied } )
+        {
+            assert( (d->buff() != pool[0]) and (d->capacity() == maxN) );
+            assert( compareBuffers( d->buff(), d->size(), pool[0], owner.size() ) );
+        }
+
+        assert( other.releaseFrame( size ) == nullptr );
+        assert( copied.releaseFrame( size ) == nullptr );
+        assert( owner.releaseFrame( size ) == pool[0] and size == 2 );
+    }
+
+    /****** Scatter/gather encoding ******/
+    {
+        // A header and samples, slices of one array so that their adjacency is defined
+        constexpr uint8_t msg[] = { 1, hdr, 2, 3, 4, 5, esc, ftr, 6 };
+
+        const Span segments[] = { { msg, 3 }, { nullptr, 0 }, { msg + 3, 6 } };
+
+        Encoder<maxN> expected;
+        assert( expected.encodeMessage( msg, sizeof(msg) ) );
+
+        Encoder<maxN> encoder;
+        assert( encoder.encodeMessage( segments, 3 ) );
+        assert( compareBuffers( encoder.buff(), encoder.size(), expected.buff(), expected.size() ) );
+        assert( not Encoder<8>().encodeMessage( segments, 3 ) );
+
+        uint8_t out[Encoder<maxN>::maxEncodedSize];
+        assert( bicoder.encodeMessage( segments, 3, out, sizeof(out) ) == expected.size() );
+        assert( compareBuffers( out, expected.size(), expected.buff(), expected.size() ) );
+
+        // A buffer larger than TSize can count
+        uint8_t bulk[100];
+        for( uint8_t i = 0; i < sizeof(bulk); ++i )
+            bulk[i] = i;
+        const Span halves[] = { { bulk, 50 }, { bulk + 50, 50 } };
+
+        Encoder<126> expectedBulk;
+        assert( expectedBulk.encodeMessage( bulk, sizeof(bulk) ) );
+
+        Frame_t large( 300 );
+        assert( Encoder<126>::encodeMessage( halves, 2, large.data(), large.size() ) == expectedBulk.size() );
+        assert( compareBuffers( large.data(), expectedBulk.size(), expectedBulk.buff(), expectedBulk.size() ) );
+        assert( Bicoder<126>::encodeMessage( halves, 2, large.data(), large.size() ) == expectedBulk.size() );
+
+        // Zero-copy output for writev()
+        iovec iov[16];
+        GatherSink<iovec> gather { iov, 16, 0 };
+        assert( Encoder<maxN>::writeMessage( segments, 3, gather ) );
+
+        Frame_t gathered;
+        for( size_t i = 0; i < gather.size; ++i )
+        {
+            const uint8_t* base = static_cast<const uint8_t*>( iov[i].iov_base );
+            gathered.insert( gathered.end(), base, base + iov[i].iov_len );
+        }
+        assert( gathered == Frame_t( expected.buff(), expected.buff() + expected.size() ) );
+
+        // The number of pieces depends on what happens to be adjacent in memory
+        assert( gather.size <= 8 );
+        GatherSink<iovec> small { iov, 2, 0 };
+        assert( not Encoder<maxN>::writeMessage( segments, 3, small ) );
+    }
+
+    /****** Encoded size ******/
+    {
+        static_assert( proto::maxEncodedSize( 126 ) == Bicoder<126>::maxEncodedSize, "" );
+        static_assert( proto::maxEncodedSize( 0 ) == 2, "" );
+
+        uint32_t seed = 3;
+        uint8_t payload[300];
+        uint8_t out[proto::maxEncodedSize( sizeof(payload) )];
+
+        for( size_t size = 0; size <= sizeof(payload); size += 13 )
+        {
+            for( size_t i = 0; i < size; ++i )
+            {
+                const uint32_t r = nextRandom( seed );
+                payload[i] = ((r % 8) == 0) ? static_cast<uint8_t>( hdr + (r >> 3) % 3 ) : static_cast<uint8_t>( r >> 8 );
+            }
+
+            const size_t expected = Encoder<300, uint16_t>::encodeMessage( payload, static_cast<uint16_t>( size ), out, sizeof(out) );
+            assert( encodedSize( payload, size ) == expected );
+
+            const Span halves[] = { { payload, size / 2 }, { payload + size / 2, size - size / 2 } };
+            assert( encodedSize( halves, 2 ) == expected );
+        }
+
+        constexpr uint8_t specials[] = { hdr, esc, ftr };
+        assert( encodedSize( specials, 3 ) == proto::maxEncodedSize( 3 ) );
+        assert( encodedSize( specials, 0 ) == 2 );
+    }
+
+    /****** Decode results ******/
+    {
+        constexpr uint8_t msgStreamEnc[] =
+        {
+            0, hdr, 1, 2, ftr,
+            hdr, 1,                         // truncated
+            hdr, 3, 4, ftr,
+            hdr, 1, 2, 3, 4, 5, ftr,        // too long
+            hdr, 1, 2, 3, esc, (hdr ^ x),   // too long in the escape
+            hdr, 1, esc,                    // truncated in the escape
+            hdr, esc, (esc ^ x), ftr
+        };
+
+        const std::vector<uint8_t> stream( msgStreamEnc, msgStreamEnc + sizeof(msgStreamEnc) );
+        const std::vector<Event_t> expected =
+        {
+            { eFrameReady, { 1, 2 } },
+            { eError, {} },
+            { eFrameReady, { 3, 4 } },
+            { eOverflow, {} },
+            { eOverflow, {} },
+            { eError, {} },
+            { eFrameReady, { esc } },
+        };
+
+        assert( (decodeEvents<Decoder<3>>( stream, 0 ) == expected) );
+        assert( (decodeEvents<Decoder<3>>( stream, 5 ) == expected) );
+        assert( (decodeEvents<Bicoder<3>>( stream, sizeof(msgStreamEnc) ) == expected) );
+
+        Decoder<3> lDecoder;
+        for( const uint8_t b : stream )
+            lDecoder.decode( b );
+        assert( lDecoder.resyncs() == 2 );
+
+        size_t consumed = 0;
+        Decoder<3> decoder;
+        assert( decoder.decode( msgStreamEnc, sizeof(msgStreamEnc), consumed ) == eFrameReady );
+        assert( consumed == 5 );
+        assert( decoder.decode( msgStreamEnc + 5, 2, consumed ) == eNeedMore );
+        assert( consumed == 2 );
+
+        for( uint32_t seed = 200; seed < 220; ++seed )
+        {
+            const std::vector<uint8_t> noisy = makeNoisyStream( seed, 200, 60 );
+            const std::vector<Event_t> events = decodeEvents<Decoder<60>>( noisy, 0 );
+
+            assert( decodeEvents<Decoder<60>>( noisy, 1 ) == events );
+            assert( decodeEvents<Decoder<60>>( noisy, 33 ) == events );
+            assert( decodeEvents<Decoder<60>>( noisy, 1 << 16 ) == events );
+        }
+    }
+
+    /****** Resynchronization skips whole chunks ******/
+    {
+        std::vector<uint8_t> stream( 1000, 0 );
+        stream.insert( stream.end(), { hdr, 1, 2, 3, 4, 5, 6, esc, (ftr ^ x), 7, ftr } );
+        stream.insert( stream.end(), 500, 0 );
+        stream.insert( stream.end(), { hdr, 8, ftr } );
+
+        Decoder<3> decoder;
+        size_t consumed = 0;
+
+        // The garbage in front and the rest of the too long message in one step
+        assert( decoder.decode( stream.data(), 1000, consumed ) == eNeedMore );
+        assert( consumed == 1000 );
+        assert( decoder.decode( stream.data() + 1000, stream.size() - 1000, consumed ) == eOverflow );
+        assert( stream[1000 + consumed] == hdr );
+        assert( consumed == 11 + 500 );
+        assert( decoder.decode( stream.data() + 1511, stream.size() - 1511, consumed ) == eFrameReady );
+        assert( consumed == 3 and decoder.size() == 1 and decoder.buff()[0] == 8 );
+    }
+
+    /****** Frame callbacks ******/
+    {
+        std::vector<Frame_t> frames;
+        auto dispatcher = makeFrameDispatcher<100>( [&frames]( Span frame )
+                                                    { frames.emplace_back( frame.data, frame.data + frame.size ); } );
+
+        for( uint32_t seed = 300; seed < 310; ++seed )
+        {
+            const std::vector<uint8_t> stream = makeNoisyStream( seed, 200, 100 );
+            const std::vector<Frame_t> expected = decodeBytewise<Decoder<100>>( stream );
+
+            frames.clear();
+            dispatcher.reset();
+
+            // Split in two to carry a message over
+            const size_t half = stream.size() / 2;
+            const size_t n = dispatcher.feed( stream.data(), half ) +
+                             dispatcher.feed( stream.data() + half, stream.size() - half );
+
+            assert( n == expected.size() );
+            assert( frames == expected );
+        }
+    }
+
+    /****** Batch decoding ******/
+    {
+        constexpr size_t nTable = 7;
+        uint32_t offsets[nTable];
+        uint32_t lengths[nTable];
+        EDecodeResult statuses[nTable];
+        std::vector<uint8_t> arena( 4 * 60 );
+
+        Decoder<60> decoder;
+
+        for( uint32_t seed = 400; seed < 410; ++seed )
+        {
+            const std::vector<uint8_t> stream = makeNoisyStream( seed, 200, 60 );
+            const std::vector<Event_t> expected = decodeEvents<Decoder<60>>( stream, 0 );
+
+            // The table and the arena run out many times
+            std::vector<Event_t> events;
+            size_t offset = 0;
+            while( true )
+            {
+                FrameTable table { offsets, lengths, statuses, nTable, 0 };
+                offset += decodeBatch( decoder, stream.data() + offset, stream.size() - offset,
+                                       arena.data(), arena.size(), table );
+                if( table.count == 0 )
+                    break;
+
+                uint32_t expectedOffset = 0;
+                for( size_t i = 0; i < table.count; ++i )
+                {
+                    assert( table.offset[i] == expectedOffset );
+                    expectedOffset += table.length[i];
+
+                    const uint8_t* frame = arena.data() + table.offset[i];
+                    events.emplace_back( table.status[i], Frame_t( frame, frame + table.length[i] ) );
+                }
+            }
+
+            assert( events == expected );
+        }
+
+        // The whole buffer at once
+        const std::vector<uint8_t> stream = makeNoisyStream( 1, 50, 60 );
+        std::vector<uint32_t> offset( 1000 ), length( 1000 );
+        std::vector<EDecodeResult> status( 1000 );
+        std::vector<uint8_t> bigArena( stream.size() + 60 );
+
+        FrameTable table { offset.data(), length.data(), status.data(), 1000, 0 };
+        decodeBatch( decoder, stream.data(), stream.size(), bigArena.data(), bigArena.size(), table );
+        assert( table.count == decodeEvents<Decoder<60>>( stream, 0 ).size() );
+        assert( decoder.buff() != bigArena.data() );
+    }
+
+    /****** Batch encoding ******/
+    {
+        constexpr uint8_t ping[] = { 1 };
+        constexpr uint8_t start[] = { 2, hdr, 3 };
+        constexpr uint8_t tooLong[12] = { 0 };
+
+        const Span burst[] = { { ping, sizeof(ping) }, { start, sizeof(start) }, { nullptr, 0 }, { ping, sizeof(ping) } };
+
+        uint8_t out[64];
+        size_t offsets[5];
+        assert( Encoder<maxN>::encodeBatch( burst, 4, out, sizeof(out), offsets ) == 4 );
+
+        constexpr uint8_t expected[] =
+            { hdr, 1, ftr, hdr, 2, esc, (hdr ^ x), 3, ftr, hdr, ftr, hdr, 1, ftr };
+        assert( compareBuffers( out, static_cast<uint8_t>( offsets[4] ), expected, sizeof(expected) ) );
+        assert( offsets[0] == 0 and offsets[1] == 3 and offsets[2] == 9 and offsets[3] == 11 );
+
+        for( size_t i = 0; i < 4; ++i )
+        {
+            Decoder<maxN> decoder;
+            assert( decoder.decodeMessage( out + offsets[i], static_cast<uint8_t>( offsets[i + 1] - offsets[i] ) ) );
+            assert( compareBuffers( decoder.buff(), decoder.size(), burst[i].data, static_cast<uint8_t>( burst[i].size ) ) );
+        }
+
+        // Out of room in the middle of the second message
+        assert( bicoder.encodeBatch( burst, 4, out, 5, offsets ) == 1 );
+        assert( offsets[1] == 3 );
+
+        // A too long payload stops the batch
+        const Span withTooLong[] = { { ping, sizeof(ping) }, { tooLong, sizeof(tooLong) }, { ping, sizeof(ping) } };
+        assert( Encoder<maxN>::encodeBatch( withTooLong, 3, out, sizeof(out), offsets ) == 1 );
+        assert( offsets[1] == 3 );
+    }
+
+    /****** In-place decoding ******/
+    {
+        for( uint32_t seed = 500; seed < 510; ++seed )
+        {
+            std::vector<uint8_t> stream = makeNoisyStream( seed, 200, 60 );
+            const std::vector<Frame_t> expected = decodeBytewise<Decoder<60>>( stream );
+
+            // A few messages at a time
+            std::vector<Frame_t> frames;
+            size_t offset = 0;
+            while( true )
+            {
+                Span found[5];
+                size_t count = 0;
+                offset += decodeInPlace( stream.data() + offset, stream.size() - offset, 60, found, 5, count );
+
+                for( size_t i = 0; i < count; ++i )
+                {
+                    assert( found[i].data > stream.data() and found[i].data < stream.data() + stream.size() );
+                    frames.emplace_back( found[i].data, found[i].data + found[i].size );
+                }
+
+                if( count < 5 )
+                    break;
+            }
+
+            assert( frames == expected );
+        }
+
+        // An incomplete message is left for later
+        uint8_t stream[] = { 0, hdr, 1, esc, (hdr ^ x), 2, ftr, 0, hdr, 3, esc, (esc ^ x) };
+        const uint8_t tail[] = { hdr, 3, esc, (esc ^ x) };
+
+        Span found[4];
+        size_t count = 0;
+        assert( decodeInPlace( stream, sizeof(stream), maxN, found, 4, count ) == 8 );
+        assert( count == 1 );
+        assert( found[0].data == stream + 2 and found[0].size == 3 );
+        assert( stream[2] == 1 and stream[3] == hdr and stream[4] == 2 );
+        assert( compareBuffers( stream + 8, 4, tail, 4 ) );
+
+        // Nothing but garbage is consumed at once
+        assert( decodeInPlace( stream, 1, maxN, found, 4, count ) == 1 );
+        assert( count == 0 );
+        assert( decodeInPlace( stream + 7, 5, maxN, found, 0, count ) == 1 );
+    }
+
+    /****** Runtime-sized decoders ******/
+    {
+        static_assert( std::is_base_of<BasicDecoder<uint16_t>, Decoder<10, uint16_t>>::value and
+                       std::is_base_of<BasicDecoder<uint16_t>, Decoder<3000, uint16_t>>::value,
+                       "Decoders of any length share the code" );
+
+        const std::vector<uint8_t> stream = makeNoisyStream( 600, 300, 100 );
+
+        // Channels of different lengths in one container
+        const uint16_t capacities[] = { 3, 20, 60, 100 };
+        std::vector<std::vector<uint8_t>> buffers;
+        std::vector<BasicDecoder<uint16_t>> decoders;
+        for( const uint16_t capacity : capacities )
+        {
+            buffers.emplace_back( capacity );
+            decoders.emplace_back( buffers.back().data(), capacity );
+        }
+
+        std::vector<std::vector<Event_t>> events( decoders.size() );
+        for( size_t d = 0; d < decoders.size(); ++d )
+        {
+            assert( decoders[d].capacity() == capacities[d] );
+            for( const uint8_t b : stream )
+            {
+                const EDecodeResult result = decoders[d].decode( b );
+                if( result == eFrameReady )
+                    events[d].emplace_back( result, Frame_t( decoders[d].buff(), decoders[d].buff() + decoders[d].size() ) );
+                else if( result != eNeedMore )
+                    events[d].emplace_back( result, Frame_t() );
+            }
+        }
+
+        assert( events[0] == (decodeEvents<Decoder<3, uint16_t>>( stream, 0 )) );
+        assert( events[1] == (decodeEvents<Decoder<20, uint16_t>>( stream, 0 )) );
+        assert( events[2] == (decodeEvents<Decoder<60, uint16_t>>( stream, 64 )) );
+        assert( events[3] == (decodeEvents<Decoder<100, uint16_t>>( stream, 64 )) );
+
+        // Buffers larger than TSize can count are used up to its maximum
+        constexpr uint8_t msgEnc[] = { hdr, 1, esc, (ftr ^ x), ftr };
+        std::vector<uint8_t> big( 256 );
+
+        BasicDecoder<> decoder( big.data(), big.size() );
+        assert( decoder.capacity() == 255 );
+        assert( decoder.decodeMessage( msgEnc, sizeof(msgEnc) ) and decoder.size() == 2 );
+
+        decoder.setBuffer( big.data(), 300 );
+        assert( decoder.capacity() == 255 );
+
+        uint32_t offset[2], length[2];
+        EDecodeResult status[2];
+        FrameTable table { offset, length, status, 2, 0 };
+        assert( decodeBatch( decoder, 1000, msgEnc, sizeof(msgEnc), big.data(), big.size(), table ) == sizeof(msgEnc) );
+        assert( table.count == 1 and status[0] == eFrameReady and length[0] == 2 );
+        assert( decoder.capacity() == 255 );
+    }
+
+    /****** Compile-time framing ******/
+    {
+        constexpr auto ping = makeFrame<0x01>();
+        static_assert( sameBytes( ping, { hdr, 0x01, ftr } ), "" );
+
+        constexpr auto start = makeFrame<0x02, hdr, 0x03>();
+        static_assert( sameBytes( start, { hdr, 0x02, esc, (hdr ^ x), 0x03, ftr } ), "" );
+
+        static_assert( makeFrame<>().size() == 2, "" );
+
+        constexpr auto query = makeFrame<constantPayload>();
+        static_assert( query.size() == sizeof(constantPayload) + 2 + 2, "" );
+
+        Encoder<maxN> encoder;
+        assert( encoder.encodeMessage( constantPayload, sizeof(constantPayload) ) );
+        assert( compareBuffers( query.data(), static_cast<uint8_t>( query.size() ), encoder.buff(), encoder.size() ) );
+
+        static constexpr std::array<uint8_t, 3> stdPayload { esc, esc, 5 };
+        constexpr auto fromStd = makeFrame<stdPayload>();
+        assert( encoder.encodeMessage( stdPayload.data(), 3 ) );
+        assert( compareBuffers( fromStd.data(), static_cast<uint8_t>( fromStd.size() ), encoder.buff(), encoder.size() ) );
+    }
+
+    /****** Escape alphabets ******/
+    {
+        // STX/DLE/ETX framing, the default special bytes are plain ones then
+        using Stx_t = Alphabet<0x02, 0x10, 0x03, 0x20>;
+
+        const uint8_t payload[] = { 0x02, hdr, 0x10, esc, 0x03, ftr, 0x41 };
+        const uint8_t expected[] = { 0x02, 0x10, 0x22, hdr, 0x10, 0x30, esc, 0x10, 0x23, ftr, 0x41, 0x03 };
+
+        Encoder<maxN, uint8_t, Stx_t> encoder;
+        assert( encoder.encodeMessage( payload, sizeof(payload) ) );
+        assert( compareBuffers( expected, sizeof(expected), encoder.buff(), encoder.size() ) );
+        assert( encodedSize<Stx_t>( payload, sizeof(payload) ) == sizeof(expected) );
+
+        constexpr auto constant = makeFrame<Stx_t, 0x02, hdr>();
+        static_assert( sameBytes( constant, { 0x02, 0x10, 0x22, hdr, 0x03 } ), "" );
+
+        // Every path of the decoder, with runs long enough for the vector scans
+        const uint8_t specials[] = { 0x02, 0x10, 0x03 };
+        Frame_t stream;
+        std::vector<Frame_t> sent;
+        uint32_t seed = 19;
+        for( int i = 0; i < 200; ++i )
+        {
+            Frame_t message( nextRandom( seed ) % maxN + 1 );
+            for( uint8_t& b : message )
+                b = static_cast<uint8_t>( nextRandom( seed ) % 8 ? 0x40 + nextRandom( seed ) % 64 : specials[nextRandom( seed ) % 3] );
+            sent.push_back( message );
+
+            uint8_t frame[Encoder<maxN, uint8_t, Stx_t>::maxEncodedSize];
+            const uint8_t n = Encoder<maxN, uint8_t, Stx_t>::encodeMessage( message.data(), static_cast<uint8_t>( message.size() ),
+                                                                            frame, sizeof(frame) );
+            assert( n != 0 );
+            stream.insert( stream.end(), frame, frame + n );
+        }
+
+        std::vector<Frame_t> received;
+        Decoder<maxN, uint8_t, Stx_t> decoder;
+        for( const uint8_t b : stream )
+        {
+            if( decoder.decode( b ) == eFrameReady )
+                received.emplace_back( decoder.buff(), decoder.buff() + decoder.size() );
+        }
+        assert( received == sent );
+
+        received.clear();
+        auto dispatcher = makeFrameDispatcher<maxN, uint8_t, Stx_t>( [&]( Span frame ) {
+            received.emplace_back( frame.data, frame.data + frame.size );
+        } );
+        assert( dispatcher.feed( stream.data(), stream.size() ) == sent.size() );
+        assert( received == sent );
+
+        std::vector<Span> frames( sent.size() );
+        size_t count = 0;
+        assert( decodeInPlace<Stx_t>( stream.data(), stream.size(), maxN, frames.data(), frames.size(), count ) == stream.size() );
+        assert( count == sent.size() );
+        for( size_t i = 0; i < count; ++i )
+            assert( Frame_t( frames[i].data, frames[i].data + frames[i].size ) == sent[i] );
+    }
+
+    /****** Parallel decoding ******/
+    {
+        for( uint32_t seed = 0; seed < 4; ++seed )
+        {
+            const std::vector<uint8_t> stream = makeNoisyStream( seed, 300, 40 );
+            const std::vector<Event_t> expected = decodeEvents<Decoder<40>>( stream, 0 );
+
+            for( const unsigned nThreads : { 1U, 2U, 3U, 8U, 1000U } )
+            {
+                const DecodedCapture capture = decodeParallel<40>( stream.data(), stream.size(), nThreads );
+                assert( capture.size() == expected.size() );
+
+                for( size_t i = 0; i < capture.size(); ++i )
+                {
+                    const uint8_t* payload = capture.arena.data() + capture.offset[i];
+                    assert( capture.status[i] == expected[i].first );
+                    assert( Frame_t( payload, payload + capture.length[i] ) == expected[i].second );
+                    assert( stream[capture.source[i]] == hdr );
+
+                    const size_t end = capture.source[i] + capture.encodedLength[i];
+                    if( capture.status[i] == eFrameReady )
+                        assert( stream[end - 1] == ftr );
+                    if( capture.status[i] == eError )
+                        assert( stream[end] == hdr );
+                    if( i + 1 < capture.size() )
+                        assert( end <= capture.source[i + 1] );
+                }
+            }
+        }
+    }
+
+    /****** Empty input ******/
+    {
+        // An empty vector has no storage at all
+        std::vector<uint8_t> empty;
+
+        Decoder<maxN> decoder;
+        size_t consumed = 1;
+        assert( decoder.decode( empty.data(), empty.size(), consumed ) == eNeedMore and consumed == 0 );
+        assert( decodeMessages( decoder, empty.data(), empty.size(), []( EDecodeResult, size_t, size_t ) {} ) == 0 );
+
+        Span found[1];
+        size_t count = 1;
+        assert( decodeInPlace( empty.data(), empty.size(), maxN, found, 1, count ) == 0 and count == 0 );
+
+        uint32_t offset[1], length[1];
+        EDecodeResult status[1];
+        uint8_t arena[maxN];
+        FrameTable table { offset, length, status, 1, 0 };
+        assert( decodeBatch( decoder, empty.data(), empty.size(), arena, sizeof(arena), table ) == 0 and table.count == 0 );
+
+        assert( decodeParallel<maxN>( empty.data(), empty.size(), 4 ).size() == 0 );
+    }
+
     //Bicoder<127> bc; // shouldn't compile
 
     std::cout << "Test has been passed !\n";
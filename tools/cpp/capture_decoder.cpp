@@ -0,0 +1,313 @@
+// Decodes every message of a raw serial capture and prints statistics, the
+// messages in hex (-x) or writes an index of them (-o).
+//
+//     capture_decoder [-m maxMessage] [-x] [-o index.bin] capture.bin
+//
+// The capture is mapped in memory and read once from start to end. With an
+// index the messages number N (-f N, repeatable) or those whose first byte
+// is type (-t type) are printed in hex, decoding nothing else :
+//
+//     capture_decoder -i index.bin [-f N]... [-t type] capture.bin
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "DataLinkSerialProtocol.h"
+
+// The index file is an IndexHeader followed by one IndexRecord per message
+// in the order of the capture, all in the byte order of the host. The file
+// is meant to be mapped : the record N is at sizeof(IndexHeader) + N * 24.
+constexpr uint32_t indexMagic = 0x58494C44;    // "DLIX"
+constexpr uint32_t indexVersion = 1;
+
+struct IndexHeader
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint64_t    count;
+};
+
+struct IndexRecord
+{
+    uint64_t    offset;             // Of the header in the capture
+    uint32_t    encodedLength;
+    uint32_t    decodedLength;      // 0 for a lost message
+    uint8_t     status;             // proto::EDecodeResult
+    uint8_t     type;               // The first decoded byte, 0 if there is none
+    uint8_t     reserved[6];
+};
+
+static_assert( (sizeof(IndexHeader) == 16) and (sizeof(IndexRecord) == 24),
+               "The index layout must not depend on the compiler" );
+
+// A read-only mapping of a whole file
+struct MappedFile
+{
+    MappedFile( const char* path, int advice );
+    ~MappedFile();
+
+    bool            isOpen() const { return m_fd >= 0; }
+    const uint8_t*  data() const { return m_data; }
+    size_t          size() const { return m_size; }
+
+    private :
+        int             m_fd { -1 };
+        const uint8_t*  m_data { nullptr };
+        size_t          m_size { 0 };
+};
+
+MappedFile::MappedFile( const char* path, int advice )
+{
+    m_fd = open( path, O_RDONLY );
+    if( m_fd < 0 )
+        return;
+
+    struct stat info;
+    if( (fstat( m_fd, &info ) != 0) or (info.st_size == 0) )
+        return;
+
+    void* data = mmap( nullptr, static_cast<size_t>( info.st_size ), PROT_READ, MAP_PRIVATE, m_fd, 0 );
+    if( data == MAP_FAILED )
+    {
+        close( m_fd );
+        m_fd = -1;
+        return;
+    }
+
+    madvise( data, static_cast<size_t>( info.st_size ), advice );
+    m_data = static_cast<const uint8_t*>( data );
+    m_size = static_cast<size_t>( info.st_size );
+}
+
+MappedFile::~MappedFile()
+{
+    if( m_data != nullptr )
+        munmap( const_cast<uint8_t*>( m_data ), m_size );
+    if( m_fd >= 0 )
+        close( m_fd );
+}
+
+const char* statusName( proto::EDecodeResult result )
+{
+    switch( result )
+    {
+        case proto::eFrameReady :   return "frame";
+        case proto::eError :        return "error";
+        case proto::eOverflow :     return "overflow";
+        default :                   return "?";
+    }
+}
+
+// Prints "offset status length : bytes in hex"
+void printMessage( size_t header, proto::EDecodeResult result, const uint8_t* data, uint32_t length, std::string& line )
+{
+    static const char digits[] = "0123456789abcdef";
+
+    line.assign( std::to_string( header ) ).append( " " ).append( statusName( result ) )
+        .append( " " ).append( std::to_string( length ) ).append( " :" );
+    for( uint32_t i = 0; i < length; ++i )
+        line.append( 1, ' ' ).append( 1, digits[data[i] >> 4] ).append( 1, digits[data[i] & 0xF] );
+    line.append( 1, '\n' );
+
+    std::cout.write( line.data(), static_cast<std::streamsize>( line.size() ) );
+}
+
+// Decodes the messages selected in the index only. Returns the exit status.
+int lookup( const MappedFile& capture, const char* indexPath, const std::vector<uint64_t>& numbers, int type )
+{
+    const MappedFile index( indexPath, MADV_RANDOM );
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>( index.data() );
+
+    if( (index.size() < sizeof(IndexHeader)) or (header->magic != indexMagic) or (header->version != indexVersion) or
+        ((index.size() - sizeof(IndexHeader)) / sizeof(IndexRecord) < header->count) )
+    {
+        std::cerr << "Not a valid index : " << indexPath << "\n";
+        return 1;
+    }
+
+    const IndexRecord* records = reinterpret_cast<const IndexRecord*>( index.data() + sizeof(IndexHeader) );
+    std::vector<uint8_t> buffer;
+    std::string line;
+    int status = 0;
+
+    const auto print = [&]( const IndexRecord& record )
+    {
+        const proto::EDecodeResult result = static_cast<proto::EDecodeResult>( record.status );
+
+        if( (record.offset > capture.size()) or (capture.size() - record.offset < record.encodedLength) )
+        {
+            std::cerr << "The index doesn't match the capture\n";
+            status = 1;
+            return;
+        }
+
+        if( result != proto::eFrameReady )
+        {
+            printMessage( record.offset, result, nullptr, 0, line );
+            return;
+        }
+
+        buffer.resize( std::max<size_t>( 1, record.decodedLength ) );
+        proto::BasicDecoder<uint32_t> decoder( buffer.data(), record.decodedLength );
+        size_t consumed = 0;
+
+        if( decoder.decode( capture.data() + record.offset, record.encodedLength, consumed ) != proto::eFrameReady )
+        {
+            std::cerr << "The index doesn't match the capture\n";
+            status = 1;
+            return;
+        }
+
+        printMessage( record.offset, result, decoder.buff(), decoder.size(), line );
+    };
+
+    for( const uint64_t n : numbers )
+    {
+        if( n < header->count )
+            print( records[n] );
+        else
+        {
+            std::cerr << "No message " << n << " (" << header->count << " in the index)\n";
+            status = 1;
+        }
+    }
+
+    if( type >= 0 )
+    {
+        for( uint64_t n = 0; n < header->count; ++n )
+        {
+            if( (records[n].decodedLength != 0) and (records[n].type == type) )
+                print( records[n] );
+        }
+    }
+
+    return status;
+}
+
+int main( int argc, char** argv )
+{
+    uint32_t maxMessage = 4096;
+    bool hex = false;
+    const char* indexPath = nullptr;
+    const char* lookupPath = nullptr;
+    std::vector<uint64_t> numbers;
+    int type = -1;
+    const char* path = nullptr;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg = argv[i];
+        if( (arg == "-m") and (i + 1 < argc) )
+            maxMessage = static_cast<uint32_t>( std::max( 1L, std::atol( argv[++i] ) ) );
+        else if( arg == "-x" )
+            hex = true;
+        else if( (arg == "-o") and (i + 1 < argc) )
+            indexPath = argv[++i];
+        else if( (arg == "-i") and (i + 1 < argc) )
+            lookupPath = argv[++i];
+        else if( (arg == "-f") and (i + 1 < argc) )
+            numbers.push_back( std::strtoull( argv[++i], nullptr, 0 ) );
+        else if( (arg == "-t") and (i + 1 < argc) )
+            type = static_cast<int>( std::strtol( argv[++i], nullptr, 0 ) & 0xFF );
+        else
+            path = argv[i];
+    }
+
+    if( path == nullptr )
+    {
+        std::cerr << "Usage : " << argv[0] << " [-m maxMessage] [-x] [-o index.bin] capture.bin\n"
+                  << "        " << argv[0] << " -i index.bin [-f N]... [-t type] capture.bin\n";
+        return 2;
+    }
+
+    const MappedFile capture( path, (lookupPath != nullptr) ? MADV_RANDOM : MADV_SEQUENTIAL );
+    if( not capture.isOpen() )
+    {
+        std::cerr << "Can't open " << path << "\n";
+        return 1;
+    }
+
+    if( lookupPath != nullptr )
+        return lookup( capture, lookupPath, numbers, type );
+
+    std::ofstream index;
+    if( indexPath != nullptr )
+    {
+        index.open( indexPath, std::ios::binary | std::ios::trunc );
+        if( not index )
+        {
+            std::cerr << "Can't create " << indexPath << "\n";
+            return 1;
+        }
+
+        // The count is known at the end only
+        const IndexHeader header { indexMagic, indexVersion, 0 };
+        index.write( reinterpret_cast<const char*>( &header ), sizeof(header) );
+    }
+
+    std::vector<uint8_t> buffer( maxMessage );
+    proto::BasicDecoder<uint32_t> decoder( buffer.data(), maxMessage );
+
+    std::string line;
+    size_t counts[4] = { 0, 0, 0, 0 };
+    size_t payloadBytes = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    proto::decodeMessages( decoder, capture.data(), capture.size(),
+                           [&]( proto::EDecodeResult result, size_t header, size_t encodedLength )
+    {
+        const uint32_t length = (result == proto::eFrameReady) ? decoder.size() : 0U;
+        ++counts[result];
+        payloadBytes += length;
+
+        if( index.is_open() )
+        {
+            const IndexRecord record { header, static_cast<uint32_t>( encodedLength ), length,
+                                       static_cast<uint8_t>( result ),
+                                       static_cast<uint8_t>( (length != 0) ? decoder.buff()[0] : 0 ), {} };
+            index.write( reinterpret_cast<const char*>( &record ), sizeof(record) );
+        }
+
+        if( hex )
+            printMessage( header, result, decoder.buff(), length, line );
+    } );
+
+    const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+    if( index.is_open() )
+    {
+        const IndexHeader header { indexMagic, indexVersion,
+                                   counts[proto::eFrameReady] + counts[proto::eError] + counts[proto::eOverflow] };
+        index.seekp( 0 );
+        index.write( reinterpret_cast<const char*>( &header ), sizeof(header) );
+        index.close();
+    }
+
+    if( not index )
+    {
+        std::cerr << "Can't write " << indexPath << "\n";
+        return 1;
+    }
+
+    std::ostream& stats = hex ? std::cerr : std::cout;
+    stats << "Capture bytes   " << capture.size() << "\n"
+          << "Frames          " << counts[proto::eFrameReady] << " (" << payloadBytes << " payload bytes)\n"
+          << "Resyncs         " << counts[proto::eError] << "\n"
+          << "Overflows       " << counts[proto::eOverflow] << "\n"
+          << "Seconds         " << seconds << "\n"
+          << "Frames/s        " << (seconds > 0 ? counts[proto::eFrameReady] / seconds : 0.0) << "\n"
+          << "MB/s            " << (seconds > 0 ? capture.size() / seconds / 1e6 : 0.0) << "\n";
+
+    return 0;
+}
@@ -0,0 +1,211 @@
+// Reads a capture of raw (unencoded) payloads and reports how many bytes
+// escaping costs with the default special bytes and with the best other
+// alphabets, i.e. the least frequent bytes of the capture.
+//
+//     escape_analyzer [-j threads] [-n best] capture.bin
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <array>
+#include <string>
+#include <cstdlib>
+
+#include "DataLinkSerialProtocol.h"
+
+using Histogram_t = std::array<uint64_t, 256>;
+
+struct Triple_t
+{
+    uint8_t     bytes[3];
+    uint64_t    cost;
+};
+
+// Counts into four tables so that runs of the same byte don't serialize
+// on a single counter
+void countBytes( const uint8_t* data, size_t size, Histogram_t& histogram )
+{
+    std::vector<Histogram_t> partial( 4, Histogram_t {} );
+    size_t i = 0;
+
+    for( ; i + 4 <= size; i += 4 )
+    {
+        ++partial[0][data[i]];
+        ++partial[1][data[i + 1]];
+        ++partial[2][data[i + 2]];
+        ++partial[3][data[i + 3]];
+    }
+    for( ; i < size; ++i )
+        ++partial[0][data[i]];
+
+    histogram.fill( 0 );
+    for( const Histogram_t& p : partial )
+    {
+        for( size_t b = 0; b < 256; ++b )
+            histogram[b] += p[b];
+    }
+}
+
+Histogram_t countBytesParallel( const std::vector<uint8_t>& data, unsigned nThreads )
+{
+    std::vector<Histogram_t> histograms( nThreads );
+    std::vector<std::thread> threads;
+    const size_t shard = (data.size() + nThreads - 1) / nThreads;
+
+    for( unsigned t = 0; t < nThreads; ++t )
+    {
+        const size_t first = std::min( data.size(), t * shard );
+        const size_t last = std::min( data.size(), first + shard );
+        threads.emplace_back( countBytes, data.data() + first, last - first, std::ref( histograms[t] ) );
+    }
+
+    Histogram_t histogram {};
+    for( unsigned t = 0; t < nThreads; ++t )
+    {
+        threads[t].join();
+        for( size_t b = 0; b < 256; ++b )
+            histogram[b] += histograms[t][b];
+    }
+
+    return histogram;
+}
+
+// A key is valid if no special byte is escaped into a special one. At most
+// four keys are invalid for any triple (0 and the pairwise XORs), 0x20 is
+// preferred as the default one.
+uint8_t findXorKey( const uint8_t* bytes )
+{
+    const auto isSpecial = [&]( int b ) { return (b == bytes[0]) or (b == bytes[1]) or (b == bytes[2]); };
+    const auto isValid = [&]( int key )
+    {
+        return (key != 0) and not isSpecial( bytes[0] ^ key ) and
+               not isSpecial( bytes[1] ^ key ) and not isSpecial( bytes[2] ^ key );
+    };
+
+    if( isValid( proto::ESpecial::eXOR ) )
+        return proto::ESpecial::eXOR;
+
+    int key = 1;
+    while( not isValid( key ) )
+        ++key;
+
+    return static_cast<uint8_t>( key );
+}
+
+// The nBest cheapest triples. Each of them is made of the nBest + 2 least
+// frequent bytes : a triple with a more frequent byte has at least nBest
+// cheaper or equal ones made by replacing it.
+std::vector<Triple_t> findBestTriples( const Histogram_t& histogram, size_t nBest )
+{
+    std::vector<uint8_t> byFrequency( 256 );
+    for( size_t b = 0; b < 256; ++b )
+        byFrequency[b] = static_cast<uint8_t>( b );
+
+    std::stable_sort( byFrequency.begin(), byFrequency.end(),
+                      [&]( uint8_t a, uint8_t b ) { return histogram[a] < histogram[b]; } );
+    byFrequency.resize( std::min<size_t>( 256, nBest + 2 ) );
+
+    std::vector<Triple_t> triples;
+    const size_t n = byFrequency.size();
+    for( size_t i = 0; i < n; ++i )
+    {
+        for( size_t j = i + 1; j < n; ++j )
+        {
+            for( size_t k = j + 1; k < n; ++k )
+            {
+                Triple_t triple { { byFrequency[i], byFrequency[j], byFrequency[k] }, 0 };
+                std::sort( triple.bytes, triple.bytes + 3 );
+                triple.cost = histogram[triple.bytes[0]] + histogram[triple.bytes[1]] + histogram[triple.bytes[2]];
+                triples.push_back( triple );
+            }
+        }
+    }
+
+    std::sort( triples.begin(), triples.end(), []( const Triple_t& a, const Triple_t& b )
+    {
+        return (a.cost != b.cost) ? (a.cost < b.cost) : std::lexicographical_compare( a.bytes, a.bytes + 3,
+                                                                                      b.bytes, b.bytes + 3 );
+    } );
+    triples.resize( std::min( nBest, triples.size() ) );
+
+    return triples;
+}
+
+// Consecutive special bytes (as the default ones) keep the cheapest lookup
+// of the escape sequences
+Triple_t findBestConsecutive( const Histogram_t& histogram )
+{
+    Triple_t best { { 0, 1, 2 }, UINT64_MAX };
+
+    for( int b = 0; b + 2 < 256; ++b )
+    {
+        const uint64_t cost = histogram[b] + histogram[b + 1] + histogram[b + 2];
+        if( cost < best.cost )
+            best = Triple_t { { uint8_t( b ), uint8_t( b + 1 ), uint8_t( b + 2 ) }, cost };
+    }
+
+    return best;
+}
+
+void printTriple( const char* title, const Triple_t& triple, uint64_t total )
+{
+    std::cout << std::left << std::setw( 20 ) << title << std::right << std::hex << std::setfill( '0' )
+              << "0x" << std::setw( 2 ) << int( triple.bytes[0] )
+              << " 0x" << std::setw( 2 ) << int( triple.bytes[1] )
+              << " 0x" << std::setw( 2 ) << int( triple.bytes[2] )
+              << " xor 0x" << std::setw( 2 ) << int( findXorKey( triple.bytes ) )
+              << std::dec << std::setfill( ' ' )
+              << " : " << triple.cost << " escapes ("
+              << std::fixed << std::setprecision( 3 ) << (total ? 100.0 * triple.cost / total : 0.0) << " %)\n";
+}
+
+int main( int argc, char** argv )
+{
+    unsigned nThreads = std::max( 1U, std::thread::hardware_concurrency() );
+    size_t nBest = 5;
+    const char* path = nullptr;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg = argv[i];
+        if( (arg == "-j") and (i + 1 < argc) )
+            nThreads = std::max( 1, std::atoi( argv[++i] ) );
+        else if( (arg == "-n") and (i + 1 < argc) )
+            nBest = static_cast<size_t>( std::max( 1, std::atoi( argv[++i] ) ) );
+        else
+            path = argv[i];
+    }
+
+    if( path == nullptr )
+    {
+        std::cerr << "Usage : " << argv[0] << " [-j threads] [-n best] capture.bin\n";
+        return 2;
+    }
+
+    std::ifstream file( path, std::ios::binary );
+    if( not file )
+    {
+        std::cerr << "Can't open " << path << "\n";
+        return 1;
+    }
+
+    const std::vector<uint8_t> data( (std::istreambuf_iterator<char>( file )), std::istreambuf_iterator<char>() );
+    const Histogram_t histogram = countBytesParallel( data, nThreads );
+
+    const Triple_t current { { proto::ESpecial::eHDR, proto::ESpecial::eESC, proto::ESpecial::eFTR },
+                             histogram[proto::ESpecial::eHDR] + histogram[proto::ESpecial::eESC] +
+                             histogram[proto::ESpecial::eFTR] };
+
+    std::cout << "Payload bytes       " << data.size() << " (" << nThreads << " threads)\n";
+    printTriple( "Default", current, data.size() );
+    printTriple( "Best consecutive", findBestConsecutive( histogram ), data.size() );
+
+    for( const Triple_t& triple : findBestTriples( histogram, nBest ) )
+        printTriple( "Best", triple, data.size() );
+
+    return 0;
+}